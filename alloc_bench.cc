@@ -0,0 +1,285 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "alloc_bench.h"
+#include "memory_block.h"
+#include "stats.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double nanoseconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+// Zeroes `bytes` at `data` with `threads` threads, each taking a run of
+// whole pages, so every page is faulted in by exactly one thread.
+void parallel_zero(void *data, uint64_t bytes, uint32_t threads) {
+  const uint64_t page = (uint64_t)::sysconf(_SC_PAGESIZE);
+  uint64_t pages = (bytes + page - 1) / page;
+  threads = (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(threads, pages));
+  uint64_t per_thread = (pages + threads - 1) / threads * page;
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++) {
+    uint64_t begin = t * per_thread;
+    if (begin >= bytes)
+      break;
+    uint64_t size = std::min(per_thread, bytes - begin);
+    workers.emplace_back(
+        [=] { std::memset(static_cast<char *>(data) + begin, 0, size); });
+  }
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+// vkCmdFillBuffer over the block on the compute queue, waited for.
+struct gpu_filler {
+  VkDevice dev = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  VkCommandPool pool = VK_NULL_HANDLE;
+  VkCommandBuffer cb = VK_NULL_HANDLE;
+  VkFence done = VK_NULL_HANDLE;
+
+  void create(gpu_system &gpu) {
+    dev = gpu.logical_device_handle;
+    queue = gpu.compute_queue_handle;
+    VkCommandPoolCreateInfo pool_info{
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+    VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &pool));
+    VkCommandBufferAllocateInfo cb_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    cb_info.commandPool = pool;
+    cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cb_info.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &cb));
+    VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &done));
+  }
+
+  // Recording is part of the cost: a job would record its own fill
+  void fill(const memory_block &block) {
+    VK_CHECK(vkResetCommandPool(dev, pool, 0));
+    VkCommandBufferBeginInfo begin_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cb, &begin_info);
+    vkCmdFillBuffer(cb, block.logical_memory_block_handle, 0, VK_WHOLE_SIZE,
+                    0);
+    vkEndCommandBuffer(cb);
+    VK_CHECK(vkResetFences(dev, 1, &done));
+    VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cb;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, done));
+    VK_CHECK(vkWaitForFences(dev, 1, &done, VK_TRUE, UINT64_MAX));
+  }
+
+  void destroy() {
+    vkDestroyFence(dev, done, nullptr);
+    vkDestroyCommandPool(dev, pool, nullptr);
+  }
+};
+
+// One block through its whole life; fills `sample` with this run's phases.
+void run_one_block(gpu_system &gpu, gpu_filler &filler, uint32_t type,
+                   uint64_t bytes, prefault_mode prefault, uint32_t threads,
+                   allocation_point &sample) {
+  memory_block block;
+  block.create(gpu.logical_device_handle, gpu.physical_device_handle, bytes,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               0, type);
+  bool host_visible =
+      block.memory_type_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+  // 1. Mapped straight away, as a job filling its input would
+  void *data = host_visible ? block.map(gpu.logical_device_handle) : nullptr;
+
+  // 2. Prefault, if asked for
+  clock_type::time_point start = clock_type::now();
+  if (prefault == prefault_mode::host_touch)
+    parallel_zero(data, bytes, threads);
+  else if (prefault == prefault_mode::gpu_fill)
+    filler.fill(block);
+  sample.prefault_ns =
+      prefault == prefault_mode::none ? 0.0 : nanoseconds_since(start);
+
+  // 3. The job's write, then the same write into now-resident pages
+  if (host_visible) {
+    start = clock_type::now();
+    std::memset(data, 0xa5, bytes);
+    sample.first_write_ns = nanoseconds_since(start);
+    start = clock_type::now();
+    std::memset(data, 0x5a, bytes);
+    sample.warm_write_ns = nanoseconds_since(start);
+    block.unmap(gpu.logical_device_handle);
+  }
+  block.destroy(gpu.logical_device_handle);
+
+  sample.create_buffer_ns = block.timings.create_buffer_ns;
+  sample.allocate_ns = block.timings.allocate_ns;
+  sample.bind_ns = block.timings.bind_ns;
+  sample.map_ns = host_visible ? block.timings.map_ns : 0.0;
+  sample.unmap_ns = host_visible ? block.timings.unmap_ns : 0.0;
+  sample.free_ns = block.timings.free_ns;
+}
+
+} // namespace
+
+const char *prefault_mode_name(prefault_mode mode) {
+  switch (mode) {
+  case prefault_mode::host_touch:
+    return "host";
+  case prefault_mode::gpu_fill:
+    return "gpu";
+  default:
+    return "none";
+  }
+}
+
+prefault_mode parse_prefault_mode(const std::string &name) {
+  for (prefault_mode mode : {prefault_mode::none, prefault_mode::host_touch,
+                             prefault_mode::gpu_fill})
+    if (name == prefault_mode_name(mode))
+      return mode;
+  throw std::invalid_argument("unknown prefault mode: " + name +
+                              " (none, host, gpu)");
+}
+
+std::vector<allocation_point>
+run_allocation_sweep(gpu_system &gpu, const allocation_options &opts) {
+  uint32_t threads = opts.touch_threads
+                         ? opts.touch_threads
+                         : std::max(1u, std::thread::hardware_concurrency());
+  gpu_filler filler;
+  filler.create(gpu);
+
+  VkPhysicalDeviceMemoryProperties mem_properties;
+  vkGetPhysicalDeviceMemoryProperties(gpu.physical_device_handle,
+                                      &mem_properties);
+
+  std::vector<allocation_point> points;
+  for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+    VkMemoryPropertyFlags flags = mem_properties.memoryTypes[i].propertyFlags;
+    // Lazily allocated memory only backs transient attachments
+    if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+      continue;
+    VkDeviceSize heap_size =
+        mem_properties.memoryHeaps[mem_properties.memoryTypes[i].heapIndex]
+            .size;
+    for (uint64_t bytes : opts.sizes) {
+      for (prefault_mode prefault : opts.prefaults) {
+        if (prefault == prefault_mode::host_touch &&
+            !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+          continue;
+        allocation_point point;
+        point.memory_type_index = i;
+        point.memory_flags = flags;
+        point.bytes = bytes;
+        point.prefault = prefault;
+        // Leave room for everyone else on the heap
+        if (bytes > heap_size / 2) {
+          point.error = "larger than half the heap";
+          points.push_back(point);
+          continue;
+        }
+
+        // 1. One warm-up life, then the measured ones
+        std::vector<allocation_point> runs(opts.repetitions + 1);
+        try {
+          for (allocation_point &run : runs)
+            run_one_block(gpu, filler, i, bytes, prefault, threads, run);
+        } catch (const std::runtime_error &e) {
+          point.error = e.what();
+          points.push_back(point);
+          continue;
+        }
+        runs.erase(runs.begin());
+
+        // 2. Medians, phase by phase
+        auto median = [&](double allocation_point::*phase) {
+          std::vector<double> samples;
+          for (const allocation_point &run : runs)
+            samples.push_back(run.*phase);
+          return samples.empty() ? 0.0 : summarize(samples).p50;
+        };
+        for (double allocation_point::*phase :
+             {&allocation_point::create_buffer_ns,
+              &allocation_point::allocate_ns, &allocation_point::bind_ns,
+              &allocation_point::map_ns, &allocation_point::prefault_ns,
+              &allocation_point::first_write_ns,
+              &allocation_point::warm_write_ns, &allocation_point::unmap_ns,
+              &allocation_point::free_ns})
+          point.*phase = median(phase);
+        points.push_back(point);
+      }
+    }
+  }
+
+  filler.destroy();
+  return points;
+}
+
+void print_allocation_report(const std::vector<allocation_point> &points,
+                             std::ostream &out) {
+  out << "Allocation life cycle, us (median); per job vs pooled = a block "
+         "of its own vs rewriting a resident one"
+      << std::endl;
+  out << std::fixed << std::setprecision(1);
+  uint32_t last_type = ~0u;
+  for (const allocation_point &p : points) {
+    if (p.memory_type_index != last_type) {
+      out << "type " << p.memory_type_index << " ("
+          << formatMemoryFlags(p.memory_flags) << ")" << std::endl;
+      last_type = p.memory_type_index;
+    }
+    out << std::setw(10) << formatBytes(p.bytes) << " | " << std::setw(4)
+        << prefault_mode_name(p.prefault);
+    if (!p.error.empty()) {
+      out << " | not viable: " << p.error << std::endl;
+      continue;
+    }
+    out << " | create " << p.create_buffer_ns * 1e-3 << " | alloc "
+        << p.allocate_ns * 1e-3 << " | bind " << p.bind_ns * 1e-3;
+    if (p.memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+      out << " | map " << p.map_ns * 1e-3;
+    if (p.prefault != prefault_mode::none)
+      out << " | prefault " << p.prefault_ns * 1e-3;
+    if (p.memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+      out << " | first write " << p.first_write_ns * 1e-3 << " | unmap "
+          << p.unmap_ns * 1e-3;
+    out << " | free " << p.free_ns * 1e-3 << " || per job "
+        << p.per_job_ns() * 1e-3;
+    if (p.memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+      out << " vs pooled " << p.warm_write_ns * 1e-3;
+    out << std::endl;
+  }
+  out << std::defaultfloat;
+}
@@ -0,0 +1,85 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// What is done to a fresh allocation before the job first writes it.
+enum class prefault_mode {
+  none,       // the job's first write takes the page faults
+  host_touch, // zeroed from the host, one slice per thread
+  gpu_fill,   // zeroed by vkCmdFillBuffer on the compute queue
+};
+
+// "none", "host", "gpu"
+const char *prefault_mode_name(prefault_mode mode);
+// Inverse of prefault_mode_name; throws std::invalid_argument otherwise.
+prefault_mode parse_prefault_mode(const std::string &name);
+
+// The life of one block of one size in one memory type, medians over the
+// repetitions, in nanoseconds. Phases a type does not have (no mapping for
+// device-only memory) stay at 0.
+struct allocation_point {
+  uint32_t memory_type_index = 0;
+  VkMemoryPropertyFlags memory_flags = 0;
+  uint64_t bytes = 0;
+  prefault_mode prefault = prefault_mode::none;
+  double create_buffer_ns = 0.0;
+  double allocate_ns = 0.0;
+  double bind_ns = 0.0;
+  double map_ns = 0.0;
+  double prefault_ns = 0.0;
+  double first_write_ns = 0.0; // the job writing the whole block, host side
+  double warm_write_ns = 0.0;  // the same write again: what a pooled block
+                               // costs
+  double unmap_ns = 0.0;
+  double free_ns = 0.0;
+  std::string error; // why the type cannot hold the block, if it can't
+
+  // Everything a job allocating its own block pays; a job reusing a pooled,
+  // already resident block pays warm_write_ns instead
+  double per_job_ns() const {
+    return create_buffer_ns + allocate_ns + bind_ns + map_ns + prefault_ns +
+           first_write_ns + unmap_ns + free_ns;
+  }
+};
+
+struct allocation_options {
+  std::vector<uint64_t> sizes = {64 * 1024, 1024 * 1024, 16 * 1024 * 1024,
+                                 256ull * 1024 * 1024};
+  std::vector<prefault_mode> prefaults = {
+      prefault_mode::none, prefault_mode::host_touch, prefault_mode::gpu_fill};
+  uint32_t repetitions = 5;
+  uint32_t touch_threads = 0; // 0: every hardware thread
+};
+
+// For every memory type a storage buffer can live in, every size and every
+// prefault mode: create, allocate and bind a memory_block, map it, prefault
+// it, write it from the host twice and free it, reading the phase costs
+// from memory_block::timings. Device-only types are allocated, filled (when
+// the mode asks for it) and freed only. A type whose heap is too small or
+// whose allocation fails gets a point with `error` set.
+std::vector<allocation_point>
+run_allocation_sweep(gpu_system &gpu, const allocation_options &opts);
+
+void print_allocation_report(const std::vector<allocation_point> &points,
+                             std::ostream &out);
@@ -0,0 +1,269 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "app_bench.h"
+#include "app_structures.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Invocations per workgroup of the wide lookup dispatch.
+constexpr uint32_t wide_group_size = 64;
+// Largest workgroup the BFS throughput run asks for.
+constexpr uint32_t bfs_group_size = 256;
+
+// A new block holding a copy of `words`.
+void upload(gpu_system &gpu, memory_block &block,
+            const std::vector<uint32_t> &words, VkMemoryPropertyFlags flags) {
+  VkDeviceSize bytes =
+      std::max<VkDeviceSize>(words.size(), 1) * sizeof(uint32_t);
+  block.create(gpu.logical_device_handle, gpu.physical_device_handle, bytes,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, flags);
+  block.write(words.data(), words.size() * sizeof(uint32_t));
+}
+
+// Median GPU time of `repetitions` runs after one warm-up; before_each, if
+// given, runs on the host ahead of every run.
+double median_ns(gpu_system &gpu, shader_pipeline &pipeline, timer &stopwatch,
+                 uint32_t repetitions,
+                 const std::function<void()> &before_each = {}) {
+  return pipeline.median_run_ns(gpu.logical_device_handle,
+                                gpu.compute_queue_handle,
+                                gpu.compute_queue_family_index, stopwatch,
+                                repetitions, before_each);
+}
+
+// hash_probe.comp and btree_lookup.comp bind {structure, start keys, result}
+// and take {lookups, workgroup size, extra...} as constants.
+void measure_lookups(gpu_system &gpu, const app_bench &bench,
+                     const std::string &shader_path,
+                     const std::vector<uint32_t> &extra_constants,
+                     const std::vector<uint32_t> &structure_words,
+                     const std::vector<uint32_t> &keys, app_point &point) {
+  VkDevice dev = gpu.logical_device_handle;
+  memory_block structure, start_keys, result;
+  upload(gpu, structure, structure_words, bench.memory_flags);
+  upload(gpu, start_keys, keys, bench.memory_flags);
+  result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+
+  // 1. One invocation: every lookup waits for the previous one
+  {
+    shader_pipeline chase;
+    chase.specialization_constants = {bench.latency_lookups, 1};
+    chase.specialization_constants.insert(
+        chase.specialization_constants.end(), extra_constants.begin(),
+        extra_constants.end());
+    chase.prepare(dev, shader_path, gpu.push_descriptor_supported);
+    chase.bind_blocks(dev, {&structure, &start_keys, &result});
+    point.ns_per_lookup = median_ns(gpu, chase, stopwatch, bench.repetitions) /
+                          bench.latency_lookups;
+    chase.destroy(dev);
+  }
+
+  // 2. Many independent walkers from different start keys
+  {
+    shader_pipeline wide;
+    wide.specialization_constants = {bench.throughput_lookups,
+                                     wide_group_size};
+    wide.specialization_constants.insert(wide.specialization_constants.end(),
+                                         extra_constants.begin(),
+                                         extra_constants.end());
+    wide.group_count_x = std::min<uint32_t>(
+        std::max<uint32_t>(bench.throughput_groups, 1),
+        gpu.device_properties.limits.maxComputeWorkGroupCount[0]);
+    wide.prepare(dev, shader_path, gpu.push_descriptor_supported);
+    wide.bind_blocks(dev, {&structure, &start_keys, &result});
+    double ns = median_ns(gpu, wide, stopwatch, bench.repetitions);
+    double lookups = (double)wide.group_count_x * wide_group_size *
+                     bench.throughput_lookups;
+    point.lookups_per_s = lookups / ns * 1e9;
+    wide.destroy(dev);
+  }
+  stopwatch.destroy(dev);
+}
+
+// csr_bfs.comp from the graph's hub, once with a workgroup of one and once
+// with a full one. Both must examine exactly the edges the host BFS does.
+void measure_bfs(gpu_system &gpu, const app_bench &bench,
+                 const csr_graph &graph, app_point &point) {
+  VkDevice dev = gpu.logical_device_handle;
+  uint32_t reached;
+  uint64_t edges;
+  bfs_reference(graph, reached, edges);
+
+  memory_block rows, columns, stamps, queue, params;
+  upload(gpu, rows, graph.row_offsets, bench.memory_flags);
+  upload(gpu, columns, graph.columns, bench.memory_flags);
+  upload(gpu, stamps, std::vector<uint32_t>(graph.vertex_count, 0),
+         bench.memory_flags);
+  queue.create(dev, gpu.physical_device_handle,
+               VkDeviceSize(graph.vertex_count) * sizeof(uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, bench.memory_flags);
+  params.create(dev, gpu.physical_device_handle, 8 * sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  volatile uint32_t *p =
+      reinterpret_cast<volatile uint32_t *>(params.map(VK_NULL_HANDLE));
+
+  // A new stamp per run marks every vertex unvisited again.
+  uint32_t stamp = 0;
+  auto next_run = [&] {
+    p[0] = graph.source;
+    p[1] = ++stamp;
+    p[2] = 0; // tail
+    p[3] = 0; // edges
+    p[4] = 0; // reached
+  };
+
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+  const VkPhysicalDeviceLimits &limits = gpu.device_properties.limits;
+  uint32_t full = std::min({bfs_group_size, limits.maxComputeWorkGroupSize[0],
+                            limits.maxComputeWorkGroupInvocations});
+  for (uint32_t group_size : {1u, full}) {
+    shader_pipeline bfs;
+    bfs.specialization_constants = {group_size};
+    bfs.prepare(dev, "csr_bfs.spv", gpu.push_descriptor_supported);
+    bfs.bind_blocks(dev, {&rows, &columns, &stamps, &queue, &params});
+    double ns = median_ns(gpu, bfs, stopwatch, bench.repetitions, next_run);
+    bfs.destroy(dev);
+
+    if (p[3] != edges || p[4] != reached) {
+      std::ostringstream why;
+      why << "workgroup of " << group_size << " examined " << p[3]
+          << " edges from " << p[4] << " vertices, host BFS " << edges
+          << " from " << reached;
+      point.error = why.str();
+    }
+    if (group_size == 1)
+      point.ns_per_lookup = ns / (double)edges;
+    else
+      point.lookups_per_s = (double)edges / ns * 1e9;
+  }
+  stopwatch.destroy(dev);
+  params.unmap(VK_NULL_HANDLE);
+
+  std::ostringstream detail;
+  detail << reached << " reached, " << edges << " edges examined";
+  point.detail = detail.str();
+}
+
+} // namespace
+
+const char *app_kernel_name(app_kernel kernel) {
+  switch (kernel) {
+  case app_kernel::btree:
+    return "btree";
+  case app_kernel::bfs:
+    return "bfs";
+  default:
+    return "hash";
+  }
+}
+
+app_kernel parse_app_kernel(const std::string &name) {
+  for (app_kernel kernel :
+       {app_kernel::hash_probe, app_kernel::btree, app_kernel::bfs})
+    if (name == app_kernel_name(kernel))
+      return kernel;
+  throw std::invalid_argument("unknown kernel: " + name);
+}
+
+void app_bench::run(gpu_system &gpu, const std::vector<uint64_t> &sizes,
+                    const std::function<void(const app_point &)> &on_point) {
+  for (app_kernel kernel : kernels) {
+    for (uint64_t target : sizes) {
+      app_point point;
+      point.kernel = kernel;
+      // Like the chains, size N is built from seed + N.
+      uint64_t size_seed = seed + target;
+      std::ostringstream detail;
+
+      switch (kernel) {
+      case app_kernel::hash_probe: {
+        // Two words a slot
+        hash_table_data table = build_hash_table(
+            (uint32_t)std::min<uint64_t>(target / 8, 1u << 30), load_factor,
+            size_seed);
+        point.bytes = table.slots.size() * sizeof(uint32_t);
+        point.elements = table.keys.size();
+        detail << "load " << table.load_factor << ", "
+               << table.mean_probe_length << " slots/lookup";
+        point.detail = detail.str();
+        measure_lookups(gpu, *this, "hash_probe.spv", {}, table.slots,
+                        table.keys, point);
+        break;
+      }
+      case app_kernel::btree: {
+        // Leaves take 8 bytes a key; inner levels add about 1/fanout more.
+        uint64_t keys = target * fanout / (8 * (uint64_t)(fanout + 1));
+        btree_data tree = build_btree(
+            (uint32_t)std::min<uint64_t>(std::max<uint64_t>(keys, 1),
+                                         0xFFFFFFF0u),
+            fanout, size_seed);
+        point.bytes = tree.words.size() * sizeof(uint32_t);
+        point.elements = tree.keys.size();
+        detail << "fanout " << tree.fanout << ", " << tree.levels
+               << " levels";
+        point.detail = detail.str();
+        measure_lookups(gpu, *this, "btree_lookup.spv", {tree.fanout},
+                        tree.words, tree.keys, point);
+        break;
+      }
+      case app_kernel::bfs: {
+        // About one offset and 2 * edge_factor columns a vertex
+        uint32_t scale = 4;
+        while (scale < 28 && (4ull << (scale + 1)) * (1 + 2 * edge_factor) <=
+                                 target)
+          scale++;
+        csr_graph graph = build_rmat_graph(scale, edge_factor, size_seed);
+        point.bytes =
+            (graph.row_offsets.size() + graph.columns.size()) *
+            sizeof(uint32_t);
+        point.elements = graph.vertex_count;
+        measure_bfs(gpu, *this, graph, point);
+        break;
+      }
+      }
+      on_point(point);
+    }
+  }
+}
+
+void print_app_point(const app_point &point, std::ostream &out) {
+  bool bfs = point.kernel == app_kernel::bfs;
+  out << formatBytes(point.bytes) << " | " << app_kernel_name(point.kernel)
+      << " | " << point.elements << (bfs ? " vertices" : " keys")
+      << " | Latency: " << point.ns_per_lookup
+      << (bfs ? " ns/edge" : " ns/lookup") << " | " << point.lookups_per_s
+      << (bfs ? " edges/s" : " lookups/s") << " | " << point.detail;
+  if (!point.error.empty())
+    out << " | MISMATCH: " << point.error;
+  out << std::endl;
+}
@@ -0,0 +1,82 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "utils.h"
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// The application-shaped kernels: what a hash join, an index lookup and a
+// graph traversal do to the memory hierarchy, next to the bare chain.
+enum class app_kernel {
+  hash_probe, // hash_probe.comp over build_hash_table
+  btree,      // btree_lookup.comp over build_btree
+  bfs,        // csr_bfs.comp over build_rmat_graph
+};
+
+// "hash", "btree", "bfs"
+const char *app_kernel_name(app_kernel kernel);
+// Inverse of app_kernel_name; throws std::invalid_argument.
+app_kernel parse_app_kernel(const std::string &name);
+
+// One structure size, measured both ways.
+struct app_point {
+  app_kernel kernel = app_kernel::hash_probe;
+  uint64_t bytes = 0;    // the structure as the kernel sees it
+  uint64_t elements = 0; // keys stored, or vertices
+  // One invocation walking dependent lookups (BFS: per edge examined)
+  double ns_per_lookup = 0.0;
+  // A wide dispatch of independent walkers (BFS: one full workgroup,
+  // edges per second)
+  double lookups_per_s = 0.0;
+  std::string detail; // load factor and probe length, levels, reach
+  std::string error;  // set when the GPU's answer disagrees with the host's
+};
+
+// Runs each kernel over structures of each size. Timings are GPU
+// timestamps, the median of `repetitions` dispatches.
+class app_bench {
+public:
+  std::vector<app_kernel> kernels = {app_kernel::hash_probe, app_kernel::btree,
+                                     app_kernel::bfs};
+  double load_factor = 0.75;  // hash table
+  uint32_t fanout = 8;        // B+-tree keys per node
+  uint32_t edge_factor = 16;  // R-MAT edges per vertex
+  uint32_t latency_lookups = 100000;   // by the single invocation
+  uint32_t throughput_lookups = 1000;  // by each of the wide dispatch's
+  uint32_t throughput_groups = 256;    // workgroups of 64 invocations
+  uint32_t repetitions = 3;
+  uint64_t seed = random_seed();
+
+  // Memory every structure is uploaded to.
+  VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  // sizes are target structure sizes in bytes; each kernel rounds them to
+  // what its structure can be (power-of-two tables, whole R-MAT scales) and
+  // reports the size it built.
+  void run(gpu_system &gpu, const std::vector<uint64_t> &sizes,
+           const std::function<void(const app_point &)> &on_point);
+};
+
+void print_app_point(const app_point &point, std::ostream &out);
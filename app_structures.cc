@@ -0,0 +1,348 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "app_structures.h"
+#include "utils.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <utility>
+
+namespace {
+
+// n distinct random keys (never empty_key), and the value of each: the key
+// after it on one random cycle through all of them. Keys are a seeded
+// bijection of 0, 1, 2, ... (odd multiply, add, then the murmur mix), so
+// they come out distinct without a set to check against.
+void make_key_cycle(uint32_t n, uint64_t seed, std::vector<uint32_t> &keys,
+                    std::vector<uint32_t> &values) {
+  uint32_t multiplier = (uint32_t)(seed >> 32) | 1u, offset = (uint32_t)seed;
+  keys.clear();
+  keys.reserve(n);
+  for (uint32_t i = 0; keys.size() < n; i++) {
+    uint32_t key = hash_key(i * multiplier + offset) ^ 0x5bd1e995u;
+    if (key != empty_key)
+      keys.push_back(key);
+  }
+
+  std::vector<uint32_t> next(n);
+  build_chain(next.data(), n, chain_layout::random, seed + 1);
+  values.resize(n);
+  for (uint32_t i = 0; i < n; i++)
+    values[i] = keys[next[i]];
+}
+
+} // namespace
+
+uint32_t hash_key(uint32_t key) {
+  key ^= key >> 16;
+  key *= 0x85ebca6bu;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35u;
+  key ^= key >> 16;
+  return key;
+}
+
+hash_table_data build_hash_table(uint32_t capacity, double load_factor,
+                                 uint64_t seed) {
+  hash_table_data table;
+  table.capacity = 2;
+  while (table.capacity < capacity && table.capacity < (1u << 30))
+    table.capacity <<= 1;
+  load_factor = std::min(std::max(load_factor, 0.0), 0.95);
+  uint32_t n = std::max<uint32_t>(1, (uint32_t)(table.capacity * load_factor));
+  table.load_factor = (double)n / table.capacity;
+
+  // 1. The keys and the cycle their values form
+  std::vector<uint32_t> values;
+  make_key_cycle(n, seed, table.keys, values);
+
+  // 2. Insert with linear probing, counting the slots each key's lookup
+  // will read
+  uint32_t mask = table.capacity - 1;
+  table.slots.assign((size_t)table.capacity * 2, empty_key);
+  uint64_t probes = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t slot = hash_key(table.keys[i]) & mask;
+    probes++;
+    while (table.slots[(size_t)slot * 2] != empty_key) {
+      slot = (slot + 1) & mask;
+      probes++;
+    }
+    table.slots[(size_t)slot * 2] = table.keys[i];
+    table.slots[(size_t)slot * 2 + 1] = values[i];
+  }
+  table.mean_probe_length = (double)probes / n;
+  return table;
+}
+
+btree_data build_btree(uint32_t key_count, uint32_t fanout, uint64_t seed) {
+  btree_data tree;
+  tree.fanout = std::min<uint32_t>(std::max<uint32_t>(fanout, 2), 256);
+  const uint32_t f = tree.fanout;
+  const size_t stride = (size_t)f * 2;
+
+  // 1. Keys with their values, in key order
+  std::vector<uint32_t> values;
+  make_key_cycle(std::max<uint32_t>(key_count, 1), seed, tree.keys, values);
+  std::vector<std::pair<uint32_t, uint32_t>> sorted(tree.keys.size());
+  for (size_t i = 0; i < sorted.size(); i++)
+    sorted[i] = {tree.keys[i], values[i]};
+  std::sort(sorted.begin(), sorted.end());
+
+  // Node 0 is the header; new nodes start out as all padding.
+  tree.node_count = 1;
+  auto new_node = [&] {
+    tree.words.resize(stride * (tree.node_count + 1), 0);
+    std::fill_n(tree.words.begin() + stride * tree.node_count, f, empty_key);
+    return tree.node_count++;
+  };
+  tree.words.assign(stride, 0);
+
+  // 2. Full leaves, left to right; remember each one's smallest key
+  std::vector<uint32_t> level_nodes, level_min;
+  for (size_t pos = 0; pos < sorted.size(); pos += f) {
+    uint32_t node = new_node();
+    size_t base = stride * node;
+    for (size_t j = 0; j < f && pos + j < sorted.size(); j++) {
+      tree.words[base + j] = sorted[pos + j].first;
+      tree.words[base + f + j] = sorted[pos + j].second;
+    }
+    level_nodes.push_back(node);
+    level_min.push_back(sorted[pos].first);
+  }
+  tree.levels = 1;
+
+  // 3. Inner levels until one node is left: key j of a node is the smallest
+  // key under child j
+  while (level_nodes.size() > 1) {
+    std::vector<uint32_t> parents, parent_min;
+    for (size_t pos = 0; pos < level_nodes.size(); pos += f) {
+      uint32_t node = new_node();
+      size_t base = stride * node;
+      for (size_t j = 0; j < f && pos + j < level_nodes.size(); j++) {
+        tree.words[base + j] = level_min[pos + j];
+        tree.words[base + f + j] = level_nodes[pos + j];
+      }
+      parents.push_back(node);
+      parent_min.push_back(level_min[pos]);
+    }
+    level_nodes.swap(parents);
+    level_min.swap(parent_min);
+    tree.levels++;
+  }
+
+  tree.words[0] = level_nodes[0];
+  tree.words[1] = tree.levels;
+  return tree;
+}
+
+csr_graph build_rmat_graph(uint32_t scale, uint32_t edge_factor,
+                           uint64_t seed) {
+  csr_graph graph;
+  scale = std::min<uint32_t>(std::max<uint32_t>(scale, 1), 28);
+  graph.vertex_count = 1u << scale;
+  uint64_t edge_count = (uint64_t)edge_factor * graph.vertex_count;
+  std::mt19937_64 g(seed);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+  // 1. Recursive quadrant picks, one bit of each endpoint per level
+  const double a = 0.57, b = 0.19, c = 0.19;
+  std::vector<uint32_t> from(edge_count), to(edge_count);
+  for (uint64_t e = 0; e < edge_count; e++) {
+    uint32_t u = 0, v = 0;
+    for (uint32_t bit = 0; bit < scale; bit++) {
+      double r = coin(g);
+      if (r >= a + b + c) {
+        u |= 1u << bit;
+        v |= 1u << bit;
+      } else if (r >= a + b) {
+        u |= 1u << bit;
+      } else if (r >= a) {
+        v |= 1u << bit;
+      }
+    }
+    from[e] = u;
+    to[e] = v;
+  }
+
+  // 2. Scatter the ids so the hubs are not all near vertex 0
+  std::vector<uint32_t> rename(graph.vertex_count);
+  std::iota(rename.begin(), rename.end(), 0u);
+  std::shuffle(rename.begin(), rename.end(), g);
+
+  // 3. Both directions of every edge into CSR, self loops dropped
+  std::vector<uint32_t> &offsets = graph.row_offsets;
+  offsets.assign((size_t)graph.vertex_count + 1, 0);
+  for (uint64_t e = 0; e < edge_count; e++) {
+    if (from[e] == to[e])
+      continue;
+    offsets[rename[from[e]] + 1]++;
+    offsets[rename[to[e]] + 1]++;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  graph.columns.resize(offsets.back());
+  for (uint64_t e = 0; e < edge_count; e++) {
+    if (from[e] == to[e])
+      continue;
+    uint32_t u = rename[from[e]], v = rename[to[e]];
+    graph.columns[fill[u]++] = v;
+    graph.columns[fill[v]++] = u;
+  }
+  from.clear();
+  from.shrink_to_fit();
+  to.clear();
+  to.shrink_to_fit();
+
+  // 4. Sort each row, drop repeated edges and close the gaps
+  uint32_t out = 0, best_degree = 0;
+  for (uint32_t v = 0; v < graph.vertex_count; v++) {
+    auto first = graph.columns.begin() + offsets[v];
+    auto last = graph.columns.begin() + offsets[v + 1];
+    std::sort(first, last);
+    last = std::unique(first, last);
+    offsets[v] = out;
+    for (auto it = first; it != last; ++it)
+      graph.columns[out++] = *it;
+    uint32_t degree = out - offsets[v];
+    if (degree > best_degree) {
+      best_degree = degree;
+      graph.source = v;
+    }
+  }
+  offsets[graph.vertex_count] = out;
+  graph.columns.resize(out);
+  graph.columns.shrink_to_fit();
+  return graph;
+}
+
+void bfs_reference(const csr_graph &graph, uint32_t &reached,
+                   uint64_t &edges) {
+  std::vector<bool> seen(graph.vertex_count, false);
+  std::vector<uint32_t> queue;
+  queue.reserve(graph.vertex_count);
+  queue.push_back(graph.source);
+  seen[graph.source] = true;
+  edges = 0;
+  for (size_t head = 0; head < queue.size(); head++) {
+    uint32_t v = queue[head];
+    for (uint32_t e = graph.row_offsets[v]; e < graph.row_offsets[v + 1];
+         e++) {
+      edges++;
+      uint32_t u = graph.columns[e];
+      if (!seen[u]) {
+        seen[u] = true;
+        queue.push_back(u);
+      }
+    }
+  }
+  reached = (uint32_t)queue.size();
+}
+
+#ifdef APP_STRUCTURES_UNIT_TEST
+
+// Looks every key up the way the kernels do and checks that the values form
+// one cycle through all keys. Needs only the Vulkan headers (for utils.h):
+//
+//   clang++ -std=c++17 -DAPP_STRUCTURES_UNIT_TEST app_structures.cc utils.cc
+//       -o app_structures_test
+//   ./app_structures_test
+#include <cassert>
+#include <iostream>
+#include <set>
+
+static uint32_t hash_lookup(const hash_table_data &t, uint32_t key) {
+  uint32_t slot = hash_key(key) & (t.capacity - 1);
+  while (t.slots[(size_t)slot * 2] != key) {
+    assert(t.slots[(size_t)slot * 2] != empty_key);
+    slot = (slot + 1) & (t.capacity - 1);
+  }
+  return t.slots[(size_t)slot * 2 + 1];
+}
+
+static uint32_t btree_lookup(const btree_data &t, uint32_t key) {
+  const uint32_t f = t.fanout;
+  uint32_t node = t.words[0];
+  for (uint32_t level = 1; level < t.words[1]; level++) {
+    size_t base = (size_t)node * 2 * f;
+    uint32_t child = 0;
+    for (uint32_t j = 1; j < f; j++)
+      if (t.words[base + j] <= key)
+        child = j;
+    node = t.words[base + f + child];
+  }
+  size_t base = (size_t)node * 2 * f;
+  for (uint32_t j = 0; j < f; j++)
+    if (t.words[base + j] == key)
+      return t.words[base + f + j];
+  assert(false && "key not in its leaf");
+  return empty_key;
+}
+
+template <typename Lookup>
+static void check_cycle(const std::vector<uint32_t> &keys, Lookup lookup) {
+  std::set<uint32_t> visited;
+  uint32_t key = keys[0];
+  for (size_t i = 0; i < keys.size(); i++) {
+    assert(visited.insert(key).second);
+    key = lookup(key);
+  }
+  assert(key == keys[0] && visited.size() == keys.size());
+}
+
+int main() {
+  hash_table_data table = build_hash_table(1000, 0.75, 7);
+  assert(table.capacity == 1024 && table.keys.size() == 768);
+  assert(table.mean_probe_length >= 1.0 && table.mean_probe_length < 4.0);
+  check_cycle(table.keys, [&](uint32_t k) { return hash_lookup(table, k); });
+
+  for (uint32_t fanout : {2u, 8u, 16u}) {
+    btree_data tree = build_btree(5000, fanout, 11);
+    uint32_t levels = 1;
+    for (uint64_t span = fanout; span < 5000; span *= fanout)
+      levels++;
+    assert(tree.levels == levels);
+    check_cycle(tree.keys, [&](uint32_t k) { return btree_lookup(tree, k); });
+  }
+  btree_data single = build_btree(1, 8, 3);
+  assert(single.levels == 1 && btree_lookup(single, single.keys[0]) ==
+                                   single.keys[0]);
+
+  csr_graph graph = build_rmat_graph(10, 16, 5);
+  for (uint32_t v = 0; v < graph.vertex_count; v++)
+    for (uint32_t e = graph.row_offsets[v]; e < graph.row_offsets[v + 1];
+         e++) {
+      uint32_t u = graph.columns[e];
+      assert(u != v);
+      if (e > graph.row_offsets[v])
+        assert(graph.columns[e - 1] < u);
+      assert(std::binary_search(graph.columns.begin() + graph.row_offsets[u],
+                                graph.columns.begin() +
+                                    graph.row_offsets[u + 1],
+                                v));
+    }
+  uint32_t reached;
+  uint64_t edges;
+  bfs_reference(graph, reached, edges);
+  assert(reached > graph.vertex_count / 4 && edges > 0);
+
+  std::cout << "app_structures tests passed" << std::endl;
+  return 0;
+}
+
+#endif // APP_STRUCTURES_UNIT_TEST
@@ -0,0 +1,87 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Host-side builders for the application-shaped kernels (app_bench.h).
+// Like build_chain, every structure is a pure function of its arguments and
+// seed, and every lookup's result names the next key to look up, so a
+// single invocation walks a dependent chain through the structure.
+
+// Key that marks an empty hash slot and pads short B+-tree nodes; never a
+// real key.
+constexpr uint32_t empty_key = 0xFFFFFFFFu;
+
+// murmur3's 32-bit finalizer; hash_probe.comp uses the same mix.
+uint32_t hash_key(uint32_t key);
+
+// An open-addressing table with linear probing.
+// slots holds capacity {key, value} pairs, two words each; the value of key
+// keys[i] is the key to probe next, and following values from any key visits
+// every key once before coming back.
+struct hash_table_data {
+  std::vector<uint32_t> slots;
+  std::vector<uint32_t> keys; // every stored key, for picking start keys
+  uint32_t capacity = 0;      // a power of two
+  double load_factor = 0.0;   // keys.size() / capacity
+  double mean_probe_length = 0.0; // slots read per successful lookup
+};
+
+// capacity is rounded up to a power of two; load_factor is clamped to
+// (0, 0.95] so every probe sequence ends.
+hash_table_data build_hash_table(uint32_t capacity, double load_factor,
+                                 uint64_t seed);
+
+// A static B+-tree packed bottom-up from sorted keys, full nodes throughout.
+// words is an array of nodes of 2 * fanout words: fanout keys (padded with
+// empty_key), then fanout slots, child node indices in inner nodes and
+// values in leaves. Node 0 is a header: word 0 is the root's node index and
+// word 1 the number of levels. Leaves come first in key order, the root last.
+// As in the hash table, a key's value is the next key to look up.
+struct btree_data {
+  std::vector<uint32_t> words;
+  std::vector<uint32_t> keys;
+  uint32_t fanout = 0;
+  uint32_t levels = 0;     // 1 = the root is a leaf
+  uint32_t node_count = 0; // including the header
+};
+
+// fanout is clamped to [2, 256]; 8 puts a node on one 64-byte line.
+btree_data build_btree(uint32_t key_count, uint32_t fanout, uint64_t seed);
+
+// An undirected graph in compressed sparse row form: the neighbours of v are
+// columns[row_offsets[v] .. row_offsets[v + 1]), sorted, without duplicates
+// or self loops.
+struct csr_graph {
+  std::vector<uint32_t> row_offsets; // vertex_count + 1 entries
+  std::vector<uint32_t> columns;
+  uint32_t vertex_count = 0;
+  uint32_t source = 0; // highest-degree vertex, where BFS starts
+};
+
+// R-MAT with the Graph500 parameters (a, b, c = 0.57, 0.19, 0.19):
+// 2^scale vertices, edge_factor * 2^scale generated edges before
+// symmetrizing, and vertex ids permuted so hubs are not clustered at 0.
+csr_graph build_rmat_graph(uint32_t scale, uint32_t edge_factor,
+                           uint64_t seed);
+
+// Vertices reached by a BFS from graph.source and the edges it examines (the
+// sum of their degrees), for checking and normalizing the GPU run.
+void bfs_reference(const csr_graph &graph, uint32_t &reached,
+                   uint64_t &edges);
@@ -3,20 +3,66 @@ set -xe
 
 # 1. Compile the Compute Shader to SPIR-V
 echo "Compiling shader..."
-glslangValidator -V lat_comp.comp -o lat_comp.comp.spv
+glslangValidator -V lat_comp.comp -o lat_comp.spv
+glslangValidator -V coherence_pingpong.comp -o coherence_pingpong.spv
+glslangValidator -V bw_read.comp -o bw_read.spv
+glslangValidator -V noop.comp -o noop.spv
+glslangValidator -V hash_probe.comp -o hash_probe.spv
+glslangValidator -V btree_lookup.comp -o btree_lookup.spv
+glslangValidator -V csr_bfs.comp -o csr_bfs.spv
+glslangValidator -V chase_ssbo_ro.comp -o chase_ssbo_ro.spv
+glslangValidator -V chase_ubo.comp -o chase_ubo.spv
+glslangValidator -V chase_utexel.comp -o chase_utexel.spv
+glslangValidator -V chase_stexel.comp -o chase_stexel.spv
+glslangValidator -V chase_image1d.comp -o chase_image1d.spv
+glslangValidator -V chase_image2d.comp -o chase_image2d.spv
+glslangValidator -V chase_push.comp -o chase_push.spv
+glslangValidator -V store_load.comp -o store_load.spv
+glslangValidator -V store_rate.comp -o store_rate.spv
+glslangValidator -V visibility_pingpong.comp -o visibility_pingpong.spv
+glslangValidator -V chain_build.comp -o chain_build.spv
 
 # 2. Compile and Link the C++ Modular Project
 echo "Compiling M4 Max Profiler..."
-clang++ -std=c++17 \
+clang++ -std=c++17 -O2 \
     main.cc \
+    alloc_bench.cc \
+    app_bench.cc \
+    app_structures.cc \
+    chain_cache.cc \
+    coherence_bench.cc \
+    core_to_core.cc \
+    cpu_bandwidth.cc \
+    cpu_clock.cc \
+    cpu_latency.cc \
+    descriptor_allocator.cc \
+    dispatch_counters.cc \
+    gpu_chain.cc \
     gpu_system.cc \
+    host_buffer.cc \
+    image_block.cc \
     memory_block.cc \
+    memory_path.cc \
+    monitor.cc \
+    multi_device.cc \
+    numa.cc \
+    numa_matrix.cc \
+    overlap_bench.cc \
+    regression.cc \
+    result_writer.cc \
     shader_pipeline.cc \
+    spirv_reflect.cc \
+    stats.cc \
+    store_bench.cc \
+    submit_bench.cc \
+    sweep_cli.cc \
+    sweep_driver.cc \
     timer.cc \
     utils.cc \
     -o m4_profiler \
     -I/opt/homebrew/include \
     -L/opt/homebrew/lib \
-    -lvulkan
+    -lvulkan \
+    -pthread
 
 echo "Build Complete. Run with: ./m4_profiler"
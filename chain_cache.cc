@@ -0,0 +1,196 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "chain_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct chain_file_header {
+  char magic[8];
+  uint32_t layout;
+  uint32_t count;
+  uint64_t seed;
+  uint64_t checksum;
+};
+static_assert(sizeof(chain_file_header) == 32, "header layout is on disk");
+
+// Version 2: chains drawn with build_chain's portable bounded draw; version 1
+// files hold another chain for the same seed and are treated as missing.
+const char chain_magic[8] = {'M', '4', 'C', 'H', 'A', 'I', 'N', '2'};
+
+// Running state of chain_checksum, so load() can feed it chunk by chunk.
+struct checksum_state {
+  static constexpr uint64_t prime = 0x100000001b3ull;
+  uint64_t lanes[4] = {0xcbf29ce484222325ull, 0x84222325cbf29ce4ull,
+                       0x9ce484222325cbf2ull, 0x2325cbf29ce48422ull};
+
+  // `count` must be even except for the last chunk.
+  void add(const uint32_t *nodes, size_t count) {
+    size_t pairs = count / 2, i = 0;
+    for (; i + 4 <= pairs; i += 4)
+      for (int l = 0; l < 4; l++)
+        lanes[l] = (lanes[l] ^ load_pair(nodes, i + l)) * prime;
+    for (; i < pairs; i++)
+      lanes[0] = (lanes[0] ^ load_pair(nodes, i)) * prime;
+    if (count % 2)
+      lanes[1] = (lanes[1] ^ nodes[count - 1]) * prime;
+  }
+
+  uint64_t finish(size_t count) const {
+    uint64_t h = count;
+    for (uint64_t lane : lanes)
+      h = (h ^ lane) * prime;
+    return h ^ (h >> 29);
+  }
+
+  static uint64_t load_pair(const uint32_t *nodes, size_t pair) {
+    uint64_t word;
+    std::memcpy(&word, nodes + 2 * pair, sizeof(word));
+    return word;
+  }
+};
+
+} // namespace
+
+uint64_t chain_checksum(const uint32_t *nodes, size_t count) {
+  checksum_state state;
+  state.add(nodes, count);
+  return state.finish(count);
+}
+
+std::string chain_cache::path(uint32_t count, chain_layout layout,
+                              uint64_t seed) const {
+  std::ostringstream name;
+  name << "chain_" << chain_layout_name(layout) << "_" << count << "_"
+       << std::hex << seed << ".bin";
+  return (std::filesystem::path(directory) / name.str()).string();
+}
+
+bool chain_cache::load(uint32_t *dst, uint32_t count, chain_layout layout,
+                       uint64_t seed) const {
+  std::string file = path(count, layout, seed);
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  // 1. Map the whole file; its size alone rules out most damage
+  const size_t bytes =
+      sizeof(chain_file_header) + (size_t)count * sizeof(uint32_t);
+  struct stat info;
+  void *mapping = MAP_FAILED;
+  if (::fstat(fd, &info) == 0 && (size_t)info.st_size == bytes)
+    mapping = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "chain cache: ignoring " << file << " (wrong size)"
+              << std::endl;
+    return false;
+  }
+  ::madvise(mapping, bytes, MADV_SEQUENTIAL);
+
+  // 2. The header has to name exactly these keys
+  chain_file_header header;
+  std::memcpy(&header, mapping, sizeof(header));
+  bool valid = std::memcmp(header.magic, chain_magic, sizeof(chain_magic)) ==
+                   0 &&
+               header.layout == (uint32_t)layout && header.count == count &&
+               header.seed == seed;
+
+  // 3. Copy and checksum in the same pass, a chunk at a time, so each chunk
+  // is hashed while it is still in cache
+  if (valid) {
+    const uint32_t *nodes = reinterpret_cast<const uint32_t *>(
+        static_cast<const char *>(mapping) + sizeof(header));
+    const size_t chunk = 256 * 1024; // nodes, 1MB; even, as add() needs
+    checksum_state state;
+    for (size_t first = 0; first < count; first += chunk) {
+      size_t n = std::min(chunk, (size_t)count - first);
+      std::memcpy(dst + first, nodes + first, n * sizeof(uint32_t));
+      state.add(nodes + first, n);
+    }
+    valid = state.finish(count) == header.checksum;
+  }
+  ::munmap(mapping, bytes);
+  if (!valid)
+    std::cerr << "chain cache: ignoring " << file
+              << " (header or checksum mismatch)" << std::endl;
+  return valid;
+}
+
+void chain_cache::save(const uint32_t *nodes, uint32_t count,
+                       chain_layout layout, uint64_t seed) const {
+  std::string file = path(count, layout, seed);
+  std::error_code ignored;
+  std::filesystem::create_directories(directory, ignored);
+
+  chain_file_header header;
+  std::memcpy(header.magic, chain_magic, sizeof(chain_magic));
+  header.layout = (uint32_t)layout;
+  header.count = count;
+  header.seed = seed;
+  header.checksum = chain_checksum(nodes, count);
+
+  // 1. A temporary of our own next to the target: concurrent runs saving
+  // the same chain each write their own file, and the last rename wins
+  std::string temporary = file + ".XXXXXX";
+  int fd = ::mkstemp(&temporary[0]);
+  if (fd < 0)
+    throw std::runtime_error("chain cache: cannot create " + temporary);
+  ::fchmod(fd, 0644);
+
+  // 2. Header and nodes, then the rename
+  const char *parts[2] = {reinterpret_cast<const char *>(&header),
+                          reinterpret_cast<const char *>(nodes)};
+  size_t sizes[2] = {sizeof(header), (size_t)count * sizeof(uint32_t)};
+  bool written = true;
+  for (int part = 0; part < 2 && written; part++) {
+    for (size_t done = 0; done < sizes[part];) {
+      ssize_t n = ::write(fd, parts[part] + done, sizes[part] - done);
+      if (n <= 0) {
+        written = false;
+        break;
+      }
+      done += (size_t)n;
+    }
+  }
+  if (::close(fd) != 0)
+    written = false;
+  if (!written) {
+    ::unlink(temporary.c_str());
+    throw std::runtime_error("chain cache: cannot write " + temporary);
+  }
+  std::filesystem::rename(temporary, file);
+}
+
+void chain_cache::fill(uint32_t *dst, uint32_t count, chain_layout layout,
+                       uint64_t seed) const {
+  if (load(dst, count, layout, seed))
+    return;
+  build_chain(dst, count, layout, seed);
+  save(dst, count, layout, seed);
+}
@@ -0,0 +1,61 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Checksum of a chain file's nodes: 64-bit FNV-1a style mixing over four
+// independent lanes of 8-byte words, so checking a 1GB chain runs at memory
+// speed rather than one multiply latency per word.
+uint64_t chain_checksum(const uint32_t *nodes, size_t count);
+
+// Chains saved on disk, one file per (count, layout, seed), so later runs
+// (after a driver update, say) skip the shuffle and walk the saved bytes as
+// they are: what a cached file pins down is its own contents, checked by the
+// checksum, whatever binary reads it.
+//
+// File: a 32-byte header {"M4CHAIN2", layout, count, seed, checksum} in
+// host byte order, then the count uint32_t nodes. load() maps the file and
+// copies it out in one sequential pass, checking the checksum on the way;
+// files that do not match their keys or checksum are reported and treated
+// as missing.
+class chain_cache {
+public:
+  std::string directory;
+
+  // <directory>/chain_<layout>_<count>_<seed in hex>.bin
+  std::string path(uint32_t count, chain_layout layout, uint64_t seed) const;
+
+  // Copies the saved chain into dst (count nodes, any host-writable memory,
+  // including uncached mappings). false when there is no valid file.
+  bool load(uint32_t *dst, uint32_t count, chain_layout layout,
+            uint64_t seed) const;
+
+  // Writes `nodes` through a uniquely named temporary file in the same
+  // directory and a rename, so concurrent runs never see half a chain.
+  // Throws std::runtime_error on I/O errors.
+  void save(const uint32_t *nodes, uint32_t count, chain_layout layout,
+            uint64_t seed) const;
+
+  // load(), or else build_chain into dst and save() it; dst must be readable
+  // (cached host memory) for the save.
+  void fill(uint32_t *dst, uint32_t count, chain_layout layout,
+            uint64_t seed) const;
+};
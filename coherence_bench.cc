@@ -0,0 +1,207 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "coherence_bench.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include "utils.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// Word offsets of the mailbox fields (see coherence_pingpong.comp).
+constexpr size_t host_to_gpu_word = 0;
+constexpr size_t gpu_to_host_word = 16;
+constexpr size_t rounds_word = 32;
+constexpr size_t status_word = 33;
+constexpr VkDeviceSize mailbox_bytes = 256;
+
+constexpr uint32_t quit_value = 0xFFFFFFFFu;
+
+// How long the host waits for one answer before declaring the type unusable
+// (includes the kernel getting scheduled at all on the first round).
+constexpr std::chrono::milliseconds answer_timeout(2000);
+
+using steady = std::chrono::steady_clock;
+
+coherence_result ping_pong_one_type(gpu_system &gpu, shader_pipeline &pipeline,
+                                    timer &stopwatch, uint32_t type_index,
+                                    VkMemoryPropertyFlags type_flags,
+                                    uint32_t rounds, uint32_t warmup_rounds) {
+  VkDevice dev = gpu.logical_device_handle;
+  coherence_result result;
+  result.memory_type_index = type_index;
+  result.memory_flags = type_flags;
+
+  // 1. The mailbox, pinned to this memory type and mapped for the whole run
+  memory_block mailbox;
+  try {
+    mailbox.create(dev, gpu.physical_device_handle, mailbox_bytes,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, type_index);
+  } catch (const std::runtime_error &) {
+    result.error = "storage buffers cannot use this memory type";
+    return result;
+  }
+
+  bool coherent = type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  volatile uint32_t *box =
+      reinterpret_cast<volatile uint32_t *>(mailbox.map(VK_NULL_HANDLE));
+  auto publish = [&] {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!coherent)
+      mailbox.sync_to_gpu(VK_NULL_HANDLE);
+  };
+  auto refresh = [&] {
+    if (!coherent)
+      mailbox.sync_from_gpu(VK_NULL_HANDLE);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  };
+
+  uint32_t total = warmup_rounds + rounds;
+  box[host_to_gpu_word] = 0;
+  box[gpu_to_host_word] = 0;
+  box[rounds_word] = total;
+  box[status_word] = 0;
+  publish();
+
+  // 2. Launch the responder without waiting for it
+  VkCommandPool pool;
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+  VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &pool));
+
+  VkCommandBuffer cb;
+  VkCommandBufferAllocateInfo cb_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cb_info.commandPool = pool;
+  cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cb_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &cb));
+
+  pipeline.bind_blocks(dev, {&mailbox});
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  vkBeginCommandBuffer(cb, &begin_info);
+  pipeline.record(cb, stopwatch);
+  vkEndCommandBuffer(cb);
+
+  VkFence done;
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &done));
+
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cb;
+  VK_CHECK(vkQueueSubmit(gpu.compute_queue_handle, 1, &submit_info, done));
+
+  // 3. Ping-pong. Each sample runs from the host's write of r to the host
+  // seeing r come back.
+  std::vector<double> samples;
+  samples.reserve(rounds);
+  for (uint32_t r = 1; r <= total; r++) {
+    auto t0 = steady::now();
+    box[host_to_gpu_word] = r;
+    publish();
+
+    bool answered = false;
+    for (uint32_t spins = 0;; spins++) {
+      refresh();
+      if (box[gpu_to_host_word] == r) {
+        answered = true;
+        break;
+      }
+      // Reading the clock costs more than a poll; check it now and then.
+      if ((spins & 1023) == 1023 && steady::now() - t0 > answer_timeout)
+        break;
+    }
+    auto t1 = steady::now();
+
+    if (!answered) {
+      box[host_to_gpu_word] = quit_value; // let the kernel finish
+      publish();
+      result.error = "no answer from the GPU in round " + std::to_string(r);
+      break;
+    }
+    result.rounds_completed = r > warmup_rounds ? r - warmup_rounds : 0;
+    if (r > warmup_rounds)
+      samples.push_back(
+          std::chrono::duration<double, std::nano>(t1 - t0).count());
+  }
+
+  // 4. The kernel either answered everything or saw QUIT / its spin limit.
+  VK_CHECK(vkWaitForFences(dev, 1, &done, VK_TRUE, UINT64_MAX));
+  vkDestroyFence(dev, done, nullptr);
+  vkDestroyCommandPool(dev, pool, nullptr);
+  mailbox.unmap(VK_NULL_HANDLE);
+
+  result.round_trip_ns = summarize(samples);
+  return result;
+}
+
+} // namespace
+
+std::vector<coherence_result>
+run_coherence_pingpong(gpu_system &gpu, const std::string &shader_path,
+                       uint32_t rounds, uint32_t warmup_rounds) {
+  VkDevice dev = gpu.logical_device_handle;
+
+  shader_pipeline pipeline;
+  pipeline.prepare(dev, shader_path, gpu.push_descriptor_supported);
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+
+  VkPhysicalDeviceMemoryProperties mem_properties;
+  vkGetPhysicalDeviceMemoryProperties(gpu.physical_device_handle,
+                                      &mem_properties);
+
+  std::vector<coherence_result> results;
+  for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+    VkMemoryPropertyFlags flags = mem_properties.memoryTypes[i].propertyFlags;
+    if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+      continue;
+    coherence_result result = ping_pong_one_type(
+        gpu, pipeline, stopwatch, i, flags, rounds, warmup_rounds);
+    result.heap_index = mem_properties.memoryTypes[i].heapIndex;
+    results.push_back(result);
+  }
+
+  stopwatch.destroy(dev);
+  pipeline.destroy(dev);
+  return results;
+}
+
+void print_coherence_report(const std::vector<coherence_result> &results,
+                            std::ostream &out) {
+  for (const coherence_result &r : results) {
+    out << "type " << r.memory_type_index << " (heap " << r.heap_index << ", "
+        << formatMemoryFlags(r.memory_flags) << ")";
+    if (!r.error.empty()) {
+      out << " | not viable: " << r.error;
+      if (r.rounds_completed > 0)
+        out << " after " << r.rounds_completed << " rounds";
+      out << std::endl;
+      continue;
+    }
+    out << " | " << r.rounds_completed << " round trips | "
+        << format_distribution(r.round_trip_ns, " ns") << std::endl;
+  }
+}
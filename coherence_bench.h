@@ -0,0 +1,49 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "stats.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Round trips measured in one host-visible memory type.
+struct coherence_result {
+  uint32_t memory_type_index = 0;
+  VkMemoryPropertyFlags memory_flags = 0;
+  uint32_t heap_index = 0;
+  uint32_t rounds_completed = 0;
+  distribution round_trip_ns; // host write -> GPU sees it -> host sees answer
+  std::string error;          // why this type is not usable, if it isn't
+};
+
+// Host <-> GPU flag ping-pong (coherence_pingpong.comp).
+// For every HOST_VISIBLE memory type a storage buffer can live in, a single
+// long-running invocation answers `rounds` host writes through a
+// persistently mapped mailbox; each round trip is timed on the host.
+// Non-coherent types pay a flush per write and an invalidate per poll, as a
+// real producer/consumer protocol would. A type on which the GPU never sees
+// the host's writes times out and is reported as not viable.
+std::vector<coherence_result>
+run_coherence_pingpong(gpu_system &gpu, const std::string &shader_path,
+                       uint32_t rounds = 10000, uint32_t warmup_rounds = 100);
+
+void print_coherence_report(const std::vector<coherence_result> &results,
+                            std::ostream &out);
@@ -0,0 +1,234 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "core_to_core.h"
+#include "cpu_clock.h"
+#include "stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+// 128 bytes covers the 64-byte line plus the adjacent-line prefetcher on
+// x86, and the 128-byte lines of Apple cores.
+constexpr size_t line_span = 128;
+
+// One atomic; odd values are pings, even values answers.
+struct alignas(line_span) single_flag {
+  std::atomic<uint32_t> token{0};
+
+  void ping(uint32_t r) { token.store(2 * r + 1, std::memory_order_release); }
+  bool answered(uint32_t r) {
+    return token.load(std::memory_order_acquire) == 2 * r + 2;
+  }
+  bool pinged(uint32_t r) {
+    return token.load(std::memory_order_acquire) == 2 * r + 1;
+  }
+  void answer(uint32_t r) { token.store(2 * r + 2, std::memory_order_release); }
+};
+
+// Separate ping and pong flags; `Gap` bytes apart.
+template <size_t Gap> struct alignas(line_span) two_flags {
+  std::atomic<uint32_t> ping_flag{0};
+  char gap[Gap];
+  std::atomic<uint32_t> pong_flag{0};
+
+  void ping(uint32_t r) { ping_flag.store(r + 1, std::memory_order_release); }
+  bool answered(uint32_t r) {
+    return pong_flag.load(std::memory_order_acquire) == r + 1;
+  }
+  bool pinged(uint32_t r) {
+    return ping_flag.load(std::memory_order_acquire) == r + 1;
+  }
+  void answer(uint32_t r) { pong_flag.store(r + 1, std::memory_order_release); }
+};
+
+using false_shared_flags = two_flags<4>;
+using padded_flags = two_flags<line_span - sizeof(std::atomic<uint32_t>)>;
+
+static_assert(sizeof(false_shared_flags) == line_span, "one line");
+static_assert(offsetof(padded_flags, pong_flag) == line_span, "two lines");
+
+// Median round trip, in ns, between an initiator on `from` and a responder
+// on `to`; negative if either thread could not be pinned, since an unpinned
+// pair says nothing about which cores the line travelled between.
+template <typename Flags>
+double ping_pong(const cpu_clock &clock, int from, int to,
+                 uint32_t rounds_per_batch, uint32_t batches) {
+  Flags flags;
+  uint32_t total_rounds = rounds_per_batch * (batches + 1);
+  std::atomic<int> arrived{0};
+  std::atomic<bool> pinned{true};
+
+  // Both threads pin first and meet here, so a failed pin on either side
+  // sends both home before any round is played.
+  auto pin_and_meet = [&](int cpu) {
+    if (!pin_current_thread(cpu))
+      pinned.store(false, std::memory_order_relaxed);
+    arrived.fetch_add(1, std::memory_order_acq_rel);
+    while (arrived.load(std::memory_order_acquire) < 2) {
+    }
+    return pinned.load(std::memory_order_relaxed);
+  };
+
+  // 1. The responder answers every round, then leaves
+  std::thread responder([&] {
+    if (!pin_and_meet(to))
+      return;
+    for (uint32_t r = 0; r < total_rounds; r++) {
+      while (!flags.pinged(r)) {
+      }
+      flags.answer(r);
+    }
+  });
+
+  // 2. The initiator times each batch; batch 0 warms the line up
+  std::vector<double> batch_ns;
+  std::thread initiator([&] {
+    if (!pin_and_meet(from))
+      return;
+    uint32_t r = 0;
+    for (uint32_t b = 0; b <= batches; b++) {
+      uint64_t t0 = cpu_clock::ticks();
+      for (uint32_t i = 0; i < rounds_per_batch; i++, r++) {
+        flags.ping(r);
+        while (!flags.answered(r)) {
+        }
+      }
+      uint64_t t1 = cpu_clock::ticks();
+      if (b > 0)
+        batch_ns.push_back(clock.to_nanoseconds(t1 - t0) / rounds_per_batch);
+    }
+  });
+
+  initiator.join();
+  responder.join();
+  if (!pinned.load())
+    return -1.0;
+  return summarize(batch_ns).p50;
+}
+
+} // namespace
+
+const char *line_layout_name(line_layout layout) {
+  switch (layout) {
+  case line_layout::false_shared:
+    return "false-shared";
+  case line_layout::padded:
+    return "padded";
+  default:
+    return "same-line";
+  }
+}
+
+core_to_core_matrix run_core_to_core(line_layout layout,
+                                     uint32_t rounds_per_batch,
+                                     uint32_t batches) {
+  cpu_clock clock;
+  clock.calibrate();
+
+  core_to_core_matrix matrix;
+  matrix.layout = layout;
+  matrix.cpus = allowed_cpus();
+  size_t n = matrix.cpus.size();
+  matrix.round_trip_ns.assign(n * n, 0.0);
+  matrix.one_way_ns.assign(n * n, 0.0);
+
+  // Pairs run one at a time so no other pair's traffic is on the fabric.
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      if (i == j)
+        continue;
+      int from = matrix.cpus[i], to = matrix.cpus[j];
+      double rtt;
+      switch (layout) {
+      case line_layout::false_shared:
+        rtt = ping_pong<false_shared_flags>(clock, from, to, rounds_per_batch,
+                                            batches);
+        break;
+      case line_layout::padded:
+        rtt = ping_pong<padded_flags>(clock, from, to, rounds_per_batch,
+                                      batches);
+        break;
+      default:
+        rtt = ping_pong<single_flag>(clock, from, to, rounds_per_batch,
+                                     batches);
+        break;
+      }
+      if (rtt < 0) {
+        matrix.pinned = false;
+        return matrix;
+      }
+      matrix.round_trip_ns[i * n + j] = rtt;
+      matrix.one_way_ns[i * n + j] = rtt / 2.0;
+    }
+  }
+  return matrix;
+}
+
+void print_core_to_core(const core_to_core_matrix &matrix, bool one_way,
+                        std::ostream &out) {
+  const std::vector<double> &m =
+      one_way ? matrix.one_way_ns : matrix.round_trip_ns;
+  size_t n = matrix.cpus.size();
+  out << line_layout_name(matrix.layout) << " "
+      << (one_way ? "one-way" : "round-trip") << " latency (ns)" << std::endl;
+  if (n < 2) {
+    out << "  needs at least two allowed CPUs" << std::endl;
+    return;
+  }
+  if (!matrix.pinned) {
+    out << "  affinity unavailable, matrix not measurable" << std::endl;
+    return;
+  }
+
+  // 1. The matrix, initiator down the side, responder across the top
+  out << std::setw(6) << "cpu";
+  for (int cpu : matrix.cpus)
+    out << std::setw(8) << cpu;
+  out << std::endl;
+  out << std::fixed << std::setprecision(1);
+  size_t best_i = 0, best_j = 1, worst_i = 0, worst_j = 1;
+  for (size_t i = 0; i < n; i++) {
+    out << std::setw(6) << matrix.cpus[i];
+    for (size_t j = 0; j < n; j++) {
+      if (i == j) {
+        out << std::setw(8) << "-";
+        continue;
+      }
+      double v = matrix.at(m, i, j);
+      out << std::setw(8) << v;
+      if (v < matrix.at(m, best_i, best_j))
+        best_i = i, best_j = j;
+      if (v > matrix.at(m, worst_i, worst_j))
+        worst_i = i, worst_j = j;
+    }
+    out << std::endl;
+  }
+
+  // 2. The extremes
+  out << "closest:  cpu " << matrix.cpus[best_i] << " -> cpu "
+      << matrix.cpus[best_j] << " " << matrix.at(m, best_i, best_j) << " ns"
+      << std::endl;
+  out << "farthest: cpu " << matrix.cpus[worst_i] << " -> cpu "
+      << matrix.cpus[worst_j] << " " << matrix.at(m, worst_i, worst_j)
+      << " ns" << std::endl;
+  out << std::defaultfloat;
+}
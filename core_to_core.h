@@ -0,0 +1,62 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Where the flags of a core-to-core ping-pong live.
+enum class line_layout {
+  same_line,    // one atomic both sides write (the line itself is the token)
+  false_shared, // a ping and a pong atomic sharing one cache line
+  padded,       // ping and pong on lines of their own
+};
+
+const char *line_layout_name(line_layout layout);
+
+// Latency of handing a cache line back and forth between every ordered pair
+// of allowed logical CPUs. Entry [i * cpus.size() + j] is cpus[i] initiating
+// and cpus[j] answering; the diagonal is 0.
+struct core_to_core_matrix {
+  line_layout layout = line_layout::same_line;
+  std::vector<int> cpus;
+  bool pinned = true; // false: a thread could not be pinned, no entries
+  std::vector<double> round_trip_ns; // median round trip of the batches
+  std::vector<double> one_way_ns;    // round trip / 2
+
+  double at(const std::vector<double> &m, size_t i, size_t j) const {
+    return m[i * cpus.size() + j];
+  }
+};
+
+// Lock-free atomic ping-pong between two threads pinned to each pair of CPUs.
+// Each pair runs `batches` timed batches of `rounds_per_batch` round trips
+// (after one untimed batch) and keeps the median batch, so a stray
+// interrupt costs one batch rather than the pair. One-way latency is half the
+// round trip: it needs no cross-core clock agreement, unlike comparing time
+// stamps taken on the two cores. Without thread affinity (macOS) no pair can
+// be placed, so the sweep stops at the first refused pin with `pinned` false.
+core_to_core_matrix run_core_to_core(line_layout layout,
+                                     uint32_t rounds_per_batch = 1000,
+                                     uint32_t batches = 11);
+
+// A cpus x cpus table of `one_way` or round-trip ns, followed by the closest
+// and farthest pairs, which is what thread affinity decisions need; only a
+// note when the matrix could not be pinned.
+void print_core_to_core(const core_to_core_matrix &matrix, bool one_way,
+                        std::ostream &out);
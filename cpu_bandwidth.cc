@@ -0,0 +1,352 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "cpu_bandwidth.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every thread's slice is a multiple of this many doubles (two 64-byte
+// lines), so the SIMD loops need no tails and slices never share a line.
+constexpr size_t slice_granule = 16;
+
+// The read kernel's result lands here so the loads cannot be dropped.
+volatile double read_sink;
+
+// 1. Plain loops, built at -O2 like everything else (build.sh); how they
+// vectorize is the compiler's call: the four read sums fill vector lanes,
+// while write and copy may become memset / memcpy calls.
+double read_scalar(const double *a, size_t n) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (size_t i = 0; i < n; i += 4) {
+    s0 += a[i];
+    s1 += a[i + 1];
+    s2 += a[i + 2];
+    s3 += a[i + 3];
+  }
+  return s0 + s1 + s2 + s3;
+}
+void write_scalar(double *a, size_t n, double s, bool) {
+  for (size_t i = 0; i < n; i++)
+    a[i] = s;
+}
+void copy_scalar(double *b, const double *a, size_t n, bool) {
+  for (size_t i = 0; i < n; i++)
+    b[i] = a[i];
+}
+void triad_scalar(double *a, const double *b, const double *c, size_t n,
+                  double s, bool) {
+  for (size_t i = 0; i < n; i++)
+    a[i] = b[i] + s * c[i];
+}
+
+#if defined(__x86_64__)
+// 2. AVX2: four accumulators to cover the add latency, stream stores on
+// request (followed by a fence so the next timing starts clean).
+__attribute__((target("avx2,fma"))) double read_avx2(const double *a,
+                                                      size_t n) {
+  __m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+  for (size_t i = 0; i < n; i += 16) {
+    s0 = _mm256_add_pd(s0, _mm256_load_pd(a + i));
+    s1 = _mm256_add_pd(s1, _mm256_load_pd(a + i + 4));
+    s2 = _mm256_add_pd(s2, _mm256_load_pd(a + i + 8));
+    s3 = _mm256_add_pd(s3, _mm256_load_pd(a + i + 12));
+  }
+  __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+  double lanes[4];
+  _mm256_storeu_pd(lanes, s);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+__attribute__((target("avx2,fma"))) void write_avx2(double *a, size_t n,
+                                                    double s, bool nt) {
+  __m256d v = _mm256_set1_pd(s);
+  if (nt) {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_stream_pd(a + i, v);
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_store_pd(a + i, v);
+  }
+}
+__attribute__((target("avx2,fma"))) void copy_avx2(double *b, const double *a,
+                                                   size_t n, bool nt) {
+  if (nt) {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_stream_pd(b + i, _mm256_load_pd(a + i));
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_store_pd(b + i, _mm256_load_pd(a + i));
+  }
+}
+__attribute__((target("avx2,fma"))) void triad_avx2(double *a,
+                                                    const double *b,
+                                                    const double *c, size_t n,
+                                                    double s, bool nt) {
+  __m256d v = _mm256_set1_pd(s);
+  if (nt) {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_stream_pd(a + i, _mm256_fmadd_pd(v, _mm256_load_pd(c + i),
+                                              _mm256_load_pd(b + i)));
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 4)
+      _mm256_store_pd(a + i, _mm256_fmadd_pd(v, _mm256_load_pd(c + i),
+                                             _mm256_load_pd(b + i)));
+  }
+}
+
+// 3. AVX-512: the same shapes, one full cache line per instruction.
+__attribute__((target("avx512f"))) double read_avx512(const double *a,
+                                                      size_t n) {
+  __m512d s0 = _mm512_setzero_pd(), s1 = s0;
+  for (size_t i = 0; i < n; i += 16) {
+    s0 = _mm512_add_pd(s0, _mm512_load_pd(a + i));
+    s1 = _mm512_add_pd(s1, _mm512_load_pd(a + i + 8));
+  }
+  double lanes[8];
+  _mm512_storeu_pd(lanes, _mm512_add_pd(s0, s1));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] +
+         lanes[6] + lanes[7];
+}
+__attribute__((target("avx512f"))) void write_avx512(double *a, size_t n,
+                                                     double s, bool nt) {
+  __m512d v = _mm512_set1_pd(s);
+  if (nt) {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_stream_pd(a + i, v);
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_store_pd(a + i, v);
+  }
+}
+__attribute__((target("avx512f"))) void copy_avx512(double *b,
+                                                    const double *a, size_t n,
+                                                    bool nt) {
+  if (nt) {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_stream_pd(b + i, _mm512_load_pd(a + i));
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_store_pd(b + i, _mm512_load_pd(a + i));
+  }
+}
+__attribute__((target("avx512f"))) void triad_avx512(double *a,
+                                                     const double *b,
+                                                     const double *c, size_t n,
+                                                     double s, bool nt) {
+  __m512d v = _mm512_set1_pd(s);
+  if (nt) {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_stream_pd(a + i, _mm512_fmadd_pd(v, _mm512_load_pd(c + i),
+                                              _mm512_load_pd(b + i)));
+    _mm_sfence();
+  } else {
+    for (size_t i = 0; i < n; i += 8)
+      _mm512_store_pd(a + i, _mm512_fmadd_pd(v, _mm512_load_pd(c + i),
+                                             _mm512_load_pd(b + i)));
+  }
+}
+#endif
+
+// Arrays a kernel walks; the working set is split evenly between them.
+size_t array_count(bandwidth_kernel kernel) {
+  switch (kernel) {
+  case bandwidth_kernel::copy:
+    return 2;
+  case bandwidth_kernel::triad:
+    return 3;
+  default:
+    return 1;
+  }
+}
+
+// All threads leave wait() together; reusable across rounds.
+class spin_barrier {
+public:
+  explicit spin_barrier(uint32_t parties) : parties_(parties) {}
+  void wait() {
+    uint32_t generation = generation_.load(std::memory_order_acquire);
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == parties_) {
+      arrived_.store(0, std::memory_order_relaxed);
+      generation_.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    while (generation_.load(std::memory_order_acquire) == generation)
+      std::this_thread::yield();
+  }
+
+private:
+  const uint32_t parties_;
+  std::atomic<uint32_t> arrived_{0};
+  std::atomic<uint32_t> generation_{0};
+};
+
+} // namespace
+
+const char *bandwidth_kernel_name(bandwidth_kernel kernel) {
+  switch (kernel) {
+  case bandwidth_kernel::write:
+    return "write";
+  case bandwidth_kernel::copy:
+    return "copy";
+  case bandwidth_kernel::triad:
+    return "triad";
+  default:
+    return "read";
+  }
+}
+
+void cpu_bandwidth_engine::create() {
+  clock_.calibrate();
+  cpus_ = cpus.empty() ? allowed_cpus() : cpus;
+
+  kernels_ = {read_scalar, write_scalar, copy_scalar, triad_scalar};
+  isa_used = "scalar";
+  non_temporal_supported = false;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  bool has_avx512 = __builtin_cpu_supports("avx512f");
+  bool has_avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  std::string want = isa;
+  if ((want == "avx512" && !has_avx512) || (want == "avx2" && !has_avx2))
+    want = "auto";
+  if (want == "avx512" || (want == "auto" && has_avx512)) {
+    kernels_ = {read_avx512, write_avx512, copy_avx512, triad_avx512};
+    isa_used = "avx512";
+    non_temporal_supported = true;
+  } else if (want == "avx2" || (want == "auto" && has_avx2)) {
+    kernels_ = {read_avx2, write_avx2, copy_avx2, triad_avx2};
+    isa_used = "avx2";
+    non_temporal_supported = true;
+  }
+#endif
+}
+
+std::vector<uint32_t> cpu_bandwidth_engine::thread_counts() const {
+  std::vector<uint32_t> counts;
+  uint32_t all = (uint32_t)cpus_.size();
+  for (uint32_t t = 1; scale_threads && t < all; t *= 2)
+    counts.push_back(t);
+  counts.push_back(all);
+  return counts;
+}
+
+// Best-of-repetitions GB/s for one configuration.
+double cpu_bandwidth_engine::measure(host_buffer &buffer, uint64_t bytes,
+                                     bandwidth_kernel kernel, bool nt,
+                                     uint32_t threads) {
+  // 1. Carve the arrays and split each one into per-thread slices
+  size_t arrays = array_count(kernel);
+  size_t per_array =
+      (size_t)(bytes / sizeof(double) / arrays) / slice_granule * slice_granule;
+  size_t per_thread = per_array / threads / slice_granule * slice_granule;
+  if (per_thread == 0)
+    return 0.0; // working set too small for this many threads
+  double *base = buffer.as<double>();
+  double *a = base, *b = base + per_array, *c = base + 2 * per_array;
+  uint64_t moved = (uint64_t)per_thread * threads * arrays * sizeof(double);
+  uint32_t passes =
+      (uint32_t)std::max<uint64_t>(1, bytes_per_timing / std::max<uint64_t>(
+                                                             moved, 1));
+
+  // 2. Each pinned thread touches its slices, then all run the kernel in
+  // lock step; thread 0 reads the clock between the barriers.
+  spin_barrier barrier(threads);
+  std::vector<uint64_t> elapsed(repetitions, 0);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      pin_current_thread(cpus_[t]);
+      size_t off = t * per_thread;
+      for (size_t k = 0; k < arrays; k++)
+        write_scalar(base + k * per_array + off, per_thread, 1.0, false);
+
+      double sum = 0.0;
+      for (uint32_t rep = 0; rep < repetitions; rep++) {
+        barrier.wait();
+        uint64_t t0 = cpu_clock::ticks();
+        for (uint32_t p = 0; p < passes; p++) {
+          switch (kernel) {
+          case bandwidth_kernel::read:
+            sum += kernels_.read(a + off, per_thread);
+            break;
+          case bandwidth_kernel::write:
+            kernels_.write(a + off, per_thread, 2.0, nt);
+            break;
+          case bandwidth_kernel::copy:
+            kernels_.copy(b + off, a + off, per_thread, nt);
+            break;
+          case bandwidth_kernel::triad:
+            kernels_.triad(a + off, b + off, c + off, per_thread, 3.0, nt);
+            break;
+          }
+        }
+        barrier.wait();
+        if (t == 0)
+          elapsed[rep] = cpu_clock::ticks() - t0;
+      }
+      read_sink = sum;
+    });
+  }
+  for (std::thread &w : workers)
+    w.join();
+
+  uint64_t best = *std::min_element(elapsed.begin(), elapsed.end());
+  double seconds = clock_.to_nanoseconds(best) * 1e-9;
+  return seconds > 0.0 ? (double)moved * passes / seconds * 1e-9 : 0.0;
+}
+
+void cpu_bandwidth_engine::run(
+    const std::vector<uint64_t> &sizes,
+    const std::function<void(const bandwidth_point &)> &on_point) {
+  for (uint64_t bytes : sizes) {
+    host_buffer buffer;
+    for (uint32_t threads : thread_counts()) {
+      // Fresh pages per thread count, so each layout is first-touched by the
+      // threads that use it.
+      buffer.create((size_t)bytes, backing, placement, cpus_.front());
+      numa_used = buffer.numa_binding;
+      for (bandwidth_kernel kernel : kernels) {
+        bool stores = kernel != bandwidth_kernel::read;
+        for (int nt = 0; nt < 2; nt++) {
+          if (nt && !(stores && include_non_temporal &&
+                      non_temporal_supported))
+            continue;
+          bandwidth_point point;
+          point.bytes = bytes;
+          point.kernel = kernel;
+          point.non_temporal = nt;
+          point.threads = threads;
+          point.gb_per_s = measure(buffer, bytes, kernel, nt, threads);
+          if (point.gb_per_s > 0.0)
+            on_point(point);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,108 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "cpu_clock.h"
+#include "host_buffer.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// STREAM-style kernels over doubles (s is a scalar):
+//   read:  sum += a[i]          write: a[i] = s
+//   copy:  b[i] = a[i]          triad: a[i] = b[i] + s * c[i]
+enum class bandwidth_kernel { read, write, copy, triad };
+
+const char *bandwidth_kernel_name(bandwidth_kernel kernel);
+
+// One measured point of a bandwidth sweep.
+struct bandwidth_point {
+  uint64_t bytes = 0; // working set: all arrays the kernel touches
+  bandwidth_kernel kernel = bandwidth_kernel::read;
+  bool non_temporal = false; // streaming stores bypassing the caches
+  uint32_t threads = 0;
+  double gb_per_s = 0.0; // bytes read + bytes written, per second (1e9)
+};
+
+// The host's bandwidth engine.
+// For each working-set size the arrays are carved out of one host_buffer
+// (the latency path's allocator, so page backing is comparable) and split
+// evenly between threads pinned one per allowed CPU; every thread first
+// touches its own slice. Thread counts double from 1 up to all allowed CPUs.
+// Kernels are picked at create(): AVX-512 when the CPU has it, else AVX2,
+// else plain loops the compiler vectorizes (which is also the arm64 path).
+class cpu_bandwidth_engine {
+public:
+  // Kernels and store flavours to sweep. Non-temporal stores only apply to
+  // kernels that store, and only where the ISA has them.
+  std::vector<bandwidth_kernel> kernels = {
+      bandwidth_kernel::read, bandwidth_kernel::write, bandwidth_kernel::copy,
+      bandwidth_kernel::triad};
+  bool include_non_temporal = true;
+
+  // Passes over the working set per timing are chosen so each moves at least
+  // this much; the best of `repetitions` timings is reported.
+  uint64_t bytes_per_timing = 256ull * 1024 * 1024;
+  uint32_t repetitions = 3;
+
+  page_backing backing = page_backing::regular;
+
+  // NUMA node the arrays are bound to; local/remote are relative to the
+  // first CPU used.
+  numa_placement placement;
+
+  // CPUs to run on, in pinning order (empty = every allowed CPU), and
+  // whether to scale up through them or only run them all at once.
+  std::vector<int> cpus;
+  bool scale_threads = true;
+
+  // "auto", "avx512", "avx2" or "scalar"; "auto" takes the widest the CPU
+  // supports. An unsupported request falls back to "auto".
+  std::string isa = "auto";
+
+  // What create() selected.
+  std::string isa_used;
+  bool non_temporal_supported = false;
+  std::string numa_used; // binding of the last buffer
+
+  void create();
+
+  // Sweeps thread counts x kernels x store flavours for each working set
+  // given in `sizes` (bytes), calling on_point as each one completes.
+  void run(const std::vector<uint64_t> &sizes,
+           const std::function<void(const bandwidth_point &)> &on_point);
+
+  // 1, 2, 4, ... and finally every CPU (only the last without scaling).
+  std::vector<uint32_t> thread_counts() const;
+
+private:
+  struct kernel_set {
+    double (*read)(const double *a, size_t n);
+    void (*write)(double *a, size_t n, double s, bool nt);
+    void (*copy)(double *b, const double *a, size_t n, bool nt);
+    void (*triad)(double *a, const double *b, const double *c, size_t n,
+                  double s, bool nt);
+  };
+
+  double measure(host_buffer &buffer, uint64_t bytes, bandwidth_kernel kernel,
+                 bool nt, uint32_t threads);
+
+  kernel_set kernels_{};
+  std::vector<int> cpus_;
+  cpu_clock clock_;
+};
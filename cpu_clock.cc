@@ -0,0 +1,107 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "cpu_clock.h"
+
+#include <thread>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+uint64_t monotonic_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+} // namespace
+
+uint64_t cpu_clock::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  // lfence keeps rdtsc from being hoisted above the loads being timed
+  _mm_lfence();
+  uint64_t t = __rdtsc();
+  _mm_lfence();
+  return t;
+#elif defined(__aarch64__)
+  uint64_t t;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(t)::"memory");
+  return t;
+#else
+  return monotonic_ns();
+#endif
+}
+
+void cpu_clock::calibrate(uint32_t calibration_ms) {
+#if defined(__x86_64__) || defined(__i386__)
+  source = "rdtsc";
+#elif defined(__aarch64__)
+  source = "cntvct_el0";
+#else
+  source = "clock_gettime";
+  ns_per_tick = 1.0;
+  return;
+#endif
+  // 1. Bracket a busy wait with both clocks; reading each pair back to back
+  // keeps the skew between them to one clock_gettime call.
+  uint64_t ns0 = monotonic_ns(), t0 = ticks();
+  uint64_t target = ns0 + (uint64_t)calibration_ms * 1000000ull;
+  uint64_t ns1 = ns0;
+  while (ns1 < target)
+    ns1 = monotonic_ns();
+  uint64_t t1 = ticks();
+
+  // 2. The counter is invariant on anything this tool targets, so one ratio
+  // holds for the run.
+  ns_per_tick = t1 > t0 ? (double)(ns1 - ns0) / (double)(t1 - t0) : 1.0;
+}
+
+std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+    return cpus;
+  }
+#endif
+  unsigned n = std::thread::hardware_concurrency();
+  for (unsigned cpu = 0; cpu < (n ? n : 1); cpu++)
+    cpus.push_back((int)cpu);
+  return cpus;
+}
+
+bool pin_current_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
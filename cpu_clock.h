@@ -0,0 +1,48 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// The host's counterpart of timer: a cheap, serialized tick counter (rdtsc on
+// x86-64, cntvct_el0 on arm64, clock_gettime elsewhere) converted to
+// nanoseconds by calibrating it against CLOCK_MONOTONIC once.
+class cpu_clock {
+public:
+  double ns_per_tick = 1.0;
+  const char *source = "clock_gettime"; // which counter ticks() reads
+
+  // Runs both clocks side by side for about `calibration_ms` and fits the
+  // ratio. Only the raw counter is read afterwards.
+  void calibrate(uint32_t calibration_ms = 50);
+
+  // Counter value, ordered after every earlier instruction.
+  static uint64_t ticks();
+
+  double to_nanoseconds(uint64_t tick_delta) const {
+    return (double)tick_delta * ns_per_tick;
+  }
+};
+
+// Logical CPUs this process may run on (sched_getaffinity), in order. Without
+// affinity support, 0..hardware_concurrency-1.
+std::vector<int> allowed_cpus();
+
+// Binds the calling thread to one logical CPU; false if the OS refused or has
+// no affinity API (macOS), in which case the thread simply runs unpinned.
+bool pin_current_thread(int cpu);
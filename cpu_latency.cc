@@ -0,0 +1,90 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "cpu_latency.h"
+#include "utils.h"
+
+#include <exception>
+#include <thread>
+
+// The final index of each walk lands here so the compiler has to perform
+// every load.
+static volatile uint32_t walk_sink;
+
+void cpu_latency_engine::create() { clock_.calibrate(); }
+
+// Returns nanoseconds per hop.
+double cpu_latency_engine::walk(const uint32_t *chain, uint32_t hops) const {
+  uint32_t current = 0;
+  uint64_t t0 = cpu_clock::ticks();
+  for (uint32_t i = 0; i < hops; i++)
+    current = chain[current];
+  uint64_t t1 = cpu_clock::ticks();
+  walk_sink = current;
+  return clock_.to_nanoseconds(t1 - t0) / (double)hops;
+}
+
+void cpu_latency_engine::run(
+    const std::vector<uint32_t> &counts,
+    const std::function<void(const sweep_point &)> &on_point) {
+  // Everything runs on one pinned thread, including the shuffle, so the
+  // chain's pages are first touched (and placed) where they are walked.
+  // Errors are carried back and rethrown here; escaping the thread would
+  // end in std::terminate.
+  std::exception_ptr error;
+  std::thread walker([&] {
+    try {
+      walk_all(counts, on_point);
+    } catch (...) {
+      error = std::current_exception();
+    }
+  });
+  walker.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void cpu_latency_engine::walk_all(
+    const std::vector<uint32_t> &counts,
+    const std::function<void(const sweep_point &)> &on_point) {
+  pinned = cpu >= 0 && pin_current_thread(cpu);
+
+  for (uint32_t count : counts) {
+    // 1. Allocate and link (the same chain builder the GPU path uses)
+    host_buffer chain;
+    chain.create((size_t)count * sizeof(uint32_t), backing, placement, cpu);
+    backing_used = chain.backing;
+    numa_used = chain.numa_binding;
+    if (cache)
+      cache->fill(chain.as<uint32_t>(), count, layout, seed + count);
+    else
+      build_chain(chain.as<uint32_t>(), count, layout, seed + count);
+
+    // 2. Warm up, then time the walk
+    for (uint32_t w = 0; w < warmup_walks; w++)
+      walk(chain.as<uint32_t>(), hops_per_measurement);
+
+    for (uint32_t rep = 0; rep < repetitions; rep++) {
+      sweep_point point;
+      point.count = count;
+      point.bytes = (VkDeviceSize)count * sizeof(uint32_t);
+      point.ns_per_hop = walk(chain.as<uint32_t>(), hops_per_measurement);
+      point.repetition = rep;
+      on_point(point);
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "cpu_clock.h"
+#include "host_buffer.h"
+#include "sweep_driver.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The CPU's side of the latency sweep.
+// A pinned thread builds each chain with build_chain (the same chain the GPU
+// walks for the same layout and seed), then follows it from node 0 for
+// hops_per_measurement dependent loads, exactly like lat_comp.comp. Points
+// come back as sweep_points so they print next to the GPU rows unchanged.
+class cpu_latency_engine {
+public:
+  // Same hop count as one lat_comp.comp dispatch.
+  uint32_t hops_per_measurement = 1000000;
+
+  // Timed walks per chain, each reported as its own point.
+  uint32_t repetitions = 1;
+
+  // Chains as in sweep_driver: build_chain(layout, seed + count).
+  chain_layout layout = chain_layout::random;
+  uint64_t seed = random_seed();
+  // Loads and saves the chains there when set, as sweep_driver::cache.
+  const chain_cache *cache = nullptr;
+
+  // Walks over the chain before the timed one; the first pass mostly
+  // measures page faults.
+  uint32_t warmup_walks = 1;
+
+  // Logical CPU the walker is pinned to (-1 = leave the thread unpinned).
+  int cpu = 0;
+
+  // Backing for the chain buffers (falls back as described in host_buffer).
+  page_backing backing = page_backing::regular;
+
+  // NUMA node the chains are bound to; local/remote are relative to `cpu`.
+  numa_placement placement;
+
+  // What the last run actually got, for the report header.
+  page_backing backing_used = page_backing::regular;
+  bool pinned = false;
+  std::string numa_used;
+
+  // Calibrates the tick counter.
+  void create();
+
+  // Measures each chain length in `counts`, in order, on a thread pinned to
+  // `cpu`, calling on_point (from that thread) as each one completes. What
+  // that thread throws (allocation, NUMA binding, the cache, on_point) is
+  // rethrown here once it has stopped.
+  void run(const std::vector<uint32_t> &counts,
+           const std::function<void(const sweep_point &)> &on_point);
+
+  const cpu_clock &clock() const { return clock_; }
+
+private:
+  double walk(const uint32_t *chain, uint32_t hops) const;
+  // run()'s body, on the walker thread
+  void walk_all(const std::vector<uint32_t> &counts,
+                const std::function<void(const sweep_point &)> &on_point);
+
+  cpu_clock clock_;
+};
@@ -0,0 +1,191 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "descriptor_allocator.h"
+#include "utils.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void make_descriptor_writes(const std::vector<shader_binding> &bindings,
+                            const std::vector<descriptor_resource> &resources,
+                            VkDescriptorSet dst_set,
+                            descriptor_write_storage &storage,
+                            std::vector<VkWriteDescriptorSet> &writes) {
+  size_t needed = 0;
+  for (const shader_binding &b : bindings)
+    needed += b.descriptor_count;
+  if (resources.size() != needed) {
+    throw std::runtime_error("descriptor_allocator: kernel declares " +
+                             std::to_string(needed) + " descriptors but " +
+                             std::to_string(resources.size()) +
+                             " resources were bound");
+  }
+
+  // Size the backing storage once so the pointers below stay valid. Each
+  // vector is indexed like `resources`; only the kind a binding uses is read.
+  storage.buffers.assign(resources.size(), VkDescriptorBufferInfo{});
+  storage.images.assign(resources.size(), VkDescriptorImageInfo{});
+  storage.texel_views.assign(resources.size(), VK_NULL_HANDLE);
+  writes.clear();
+  writes.reserve(bindings.size());
+
+  size_t next = 0;
+  for (const shader_binding &b : bindings) {
+    auto mismatch = [&](const char *wanted) {
+      return std::runtime_error("descriptor_allocator: binding " +
+                                std::to_string(b.binding) + " needs " +
+                                wanted);
+    };
+
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = dst_set;
+    write.dstBinding = b.binding;
+    write.descriptorType = b.descriptor_type;
+    write.descriptorCount = b.descriptor_count;
+
+    for (uint32_t i = 0; i < b.descriptor_count; i++, next++) {
+      const descriptor_resource &r = resources[next];
+      switch (b.descriptor_type) {
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        if (r.block == nullptr)
+          throw mismatch("a buffer");
+        storage.buffers[next].buffer = r.block->logical_memory_block_handle;
+        storage.buffers[next].offset = 0;
+        storage.buffers[next].range = VK_WHOLE_SIZE;
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        if (r.texel_view == VK_NULL_HANDLE)
+          throw mismatch("a texel buffer view");
+        storage.texel_views[next] = r.texel_view;
+        break;
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+        if (r.image == nullptr)
+          throw mismatch("an image_block");
+        storage.images[next].sampler = r.image->sampler_handle;
+        storage.images[next].imageView = r.image->view_handle;
+        storage.images[next].imageLayout =
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        break;
+      default:
+        throw mismatch("a descriptor type this allocator does not write");
+      }
+    }
+
+    size_t first = next - b.descriptor_count;
+    write.pBufferInfo = &storage.buffers[first];
+    write.pImageInfo = &storage.images[first];
+    write.pTexelBufferView = &storage.texel_views[first];
+    writes.push_back(write);
+  }
+}
+
+void descriptor_allocator::create(VkDevice logical_device,
+                                  VkDescriptorSetLayout layout,
+                                  const std::vector<shader_binding> &bindings,
+                                  uint32_t max_sets) {
+  device_handle_ = logical_device;
+  layout_ = layout;
+  bindings_ = bindings;
+  max_sets_ = max_sets;
+
+  // 1. One pool entry per descriptor type, big enough for max_sets copies of
+  // the layout. FREE_DESCRIPTOR_SET lets us recycle single sets.
+  std::map<VkDescriptorType, uint32_t> per_type;
+  for (const shader_binding &b : bindings)
+    per_type[b.descriptor_type] += b.descriptor_count * max_sets;
+
+  std::vector<VkDescriptorPoolSize> pool_sizes;
+  for (const auto &entry : per_type)
+    pool_sizes.push_back({entry.first, entry.second});
+
+  VkDescriptorPoolCreateInfo pool_info{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  pool_info.maxSets = max_sets;
+  pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
+  pool_info.pPoolSizes = pool_sizes.data();
+
+  VK_CHECK(vkCreateDescriptorPool(logical_device, &pool_info, nullptr, &pool_));
+}
+
+VkDescriptorSet
+descriptor_allocator::acquire(
+    const std::vector<descriptor_resource> &resources) {
+  cache_key key;
+  key.reserve(resources.size());
+  for (const descriptor_resource &r : resources) {
+    if (r.image != nullptr)
+      key.emplace_back(VK_NULL_HANDLE, VK_NULL_HANDLE, r.image->image_handle,
+                       r.image->creation_serial);
+    else
+      key.emplace_back(r.block ? r.block->logical_memory_block_handle
+                               : VK_NULL_HANDLE,
+                       r.texel_view, VK_NULL_HANDLE,
+                       r.block ? r.block->creation_serial : 0);
+  }
+
+  // 1. Cache hit: move to the front and hand it back untouched.
+  auto hit = index_.find(key);
+  if (hit != index_.end()) {
+    lru_.splice(lru_.begin(), lru_, hit->second);
+    return hit->second->set;
+  }
+
+  // 2. Pool full: recycle the least recently used set.
+  if (lru_.size() >= max_sets_) {
+    cache_entry &oldest = lru_.back();
+    VK_CHECK(vkFreeDescriptorSets(device_handle_, pool_, 1, &oldest.set));
+    index_.erase(oldest.key);
+    lru_.pop_back();
+  }
+
+  // 3. Allocate a fresh set and point it at the resources.
+  VkDescriptorSetAllocateInfo alloc_info{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  alloc_info.descriptorPool = pool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &layout_;
+
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VK_CHECK(vkAllocateDescriptorSets(device_handle_, &alloc_info, &set));
+
+  descriptor_write_storage storage;
+  std::vector<VkWriteDescriptorSet> writes;
+  make_descriptor_writes(bindings_, resources, set, storage, writes);
+  vkUpdateDescriptorSets(device_handle_, (uint32_t)writes.size(),
+                         writes.data(), 0, nullptr);
+
+  lru_.push_front({key, set});
+  index_[key] = lru_.begin();
+  return set;
+}
+
+void descriptor_allocator::destroy(VkDevice /*logical_device*/) {
+  if (pool_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device_handle_, pool_, nullptr);
+
+  pool_ = VK_NULL_HANDLE;
+  layout_ = VK_NULL_HANDLE;
+  device_handle_ = VK_NULL_HANDLE;
+  lru_.clear();
+  index_.clear();
+}
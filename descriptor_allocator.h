@@ -0,0 +1,109 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "image_block.h"
+#include "memory_block.h"
+#include "spirv_reflect.h"
+#include <list>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// What one descriptor points at:
+//   storage / uniform buffer           block
+//   uniform / storage texel buffer     block, through texel_view
+//   sampled image / combined sampler   image (its view and its sampler)
+//   sampler                            image (its sampler only)
+// Converts implicitly from memory_block *, so buffer-only kernels keep
+// binding a plain list of blocks.
+struct descriptor_resource {
+  memory_block *block = nullptr;
+  VkBufferView texel_view = VK_NULL_HANDLE;
+  image_block *image = nullptr;
+
+  descriptor_resource() = default;
+  descriptor_resource(memory_block *b) : block(b) {}
+  descriptor_resource(memory_block *b, VkBufferView view)
+      : block(b), texel_view(view) {}
+  descriptor_resource(image_block *i) : image(i) {}
+};
+
+// The info structs VkWriteDescriptorSet points into, one vector per kind.
+struct descriptor_write_storage {
+  std::vector<VkDescriptorBufferInfo> buffers;
+  std::vector<VkDescriptorImageInfo> images;
+  std::vector<VkBufferView> texel_views;
+};
+
+// Fills `writes` so that the descriptors in `bindings` point at
+// `resources`, in binding order (an arrayed binding consumes several
+// consecutive resources). `storage` is resized here so the pointers in the
+// writes stay valid for as long as it is not touched again. Throws
+// std::runtime_error when a resource does not fit its binding's type.
+// dst_set may be VK_NULL_HANDLE when the writes are used as push descriptors.
+void make_descriptor_writes(const std::vector<shader_binding> &bindings,
+                            const std::vector<descriptor_resource> &resources,
+                            VkDescriptorSet dst_set,
+                            descriptor_write_storage &storage,
+                            std::vector<VkWriteDescriptorSet> &writes);
+
+// The "Filing Cabinet" for descriptor sets.
+// One pool, sized up front for many sets of a single layout. Sets are cached
+// by the resources they point at, so re-binding the same ones costs a map
+// lookup instead of an allocate + update. When the pool is full the least
+// recently used set is recycled; with a few sets in flight at a time and a
+// capacity of dozens, a set is never recycled while the GPU still reads it.
+class descriptor_allocator {
+public:
+  // Creates the pool. `bindings` is the reflected layout of the kernel.
+  void create(VkDevice logical_device, VkDescriptorSetLayout layout,
+              const std::vector<shader_binding> &bindings,
+              uint32_t max_sets = 64);
+
+  // Returns a set whose bindings point at `resources`, reusing a cached one
+  // when the very same resources were bound before.
+  VkDescriptorSet acquire(const std::vector<descriptor_resource> &resources);
+
+  // Number of sets currently held in the cache.
+  size_t cached_sets() const { return lru_.size(); }
+
+  // Frees the pool (and with it every set handed out so far).
+  void destroy(VkDevice logical_device);
+
+private:
+  // A resource is identified by its handles plus the serial number that
+  // create() stamps on the block or image: the driver is free to hand out a
+  // just-destroyed handle value again, and a stale set must not match it.
+  using cache_key =
+      std::vector<std::tuple<VkBuffer, VkBufferView, VkImage, uint64_t>>;
+  struct cache_entry {
+    cache_key key;
+    VkDescriptorSet set;
+  };
+
+  VkDevice device_handle_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout layout_ = VK_NULL_HANDLE;
+  VkDescriptorPool pool_ = VK_NULL_HANDLE;
+  std::vector<shader_binding> bindings_;
+  uint32_t max_sets_ = 0;
+
+  std::list<cache_entry> lru_; // most recently used at the front
+  std::map<cache_key, std::list<cache_entry>::iterator> index_;
+};
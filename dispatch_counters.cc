@@ -0,0 +1,280 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "dispatch_counters.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace {
+
+// The profiling lock belongs to the device, not to a query pool; several
+// dispatch_counters (the sweep's two slots, say) share it.
+std::mutex lock_mutex;
+std::map<VkDevice, uint32_t> lock_holders;
+
+bool acquire_profiling_lock(VkDevice device,
+                            PFN_vkAcquireProfilingLockKHR fn) {
+  std::lock_guard<std::mutex> guard(lock_mutex);
+  if (lock_holders[device] == 0) {
+    VkAcquireProfilingLockInfoKHR lock_info{
+        VK_STRUCTURE_TYPE_ACQUIRE_PROFILING_LOCK_INFO_KHR};
+    lock_info.timeout = 1000000000; // 1 s
+    if (fn(device, &lock_info) != VK_SUCCESS)
+      return false;
+  }
+  lock_holders[device]++;
+  return true;
+}
+
+void release_profiling_lock(VkDevice device,
+                            PFN_vkReleaseProfilingLockKHR fn) {
+  std::lock_guard<std::mutex> guard(lock_mutex);
+  if (--lock_holders[device] == 0) {
+    lock_holders.erase(device);
+    fn(device);
+  }
+}
+
+const char *unit_name(VkPerformanceCounterUnitKHR unit) {
+  switch (unit) {
+  case VK_PERFORMANCE_COUNTER_UNIT_PERCENTAGE_KHR:
+    return "%";
+  case VK_PERFORMANCE_COUNTER_UNIT_NANOSECONDS_KHR:
+    return "ns";
+  case VK_PERFORMANCE_COUNTER_UNIT_BYTES_KHR:
+    return "bytes";
+  case VK_PERFORMANCE_COUNTER_UNIT_BYTES_PER_SECOND_KHR:
+    return "bytes/s";
+  case VK_PERFORMANCE_COUNTER_UNIT_KELVIN_KHR:
+    return "K";
+  case VK_PERFORMANCE_COUNTER_UNIT_WATTS_KHR:
+    return "W";
+  case VK_PERFORMANCE_COUNTER_UNIT_VOLTS_KHR:
+    return "V";
+  case VK_PERFORMANCE_COUNTER_UNIT_AMPS_KHR:
+    return "A";
+  case VK_PERFORMANCE_COUNTER_UNIT_HERTZ_KHR:
+    return "Hz";
+  case VK_PERFORMANCE_COUNTER_UNIT_CYCLES_KHR:
+    return "cycles";
+  default:
+    return "";
+  }
+}
+
+std::string lower(std::string text) {
+  for (char &c : text)
+    c = (char)std::tolower((unsigned char)c);
+  return text;
+}
+
+double as_double(const VkPerformanceCounterResultKHR &result,
+                 VkPerformanceCounterStorageKHR storage) {
+  switch (storage) {
+  case VK_PERFORMANCE_COUNTER_STORAGE_INT32_KHR:
+    return result.int32;
+  case VK_PERFORMANCE_COUNTER_STORAGE_INT64_KHR:
+    return (double)result.int64;
+  case VK_PERFORMANCE_COUNTER_STORAGE_UINT32_KHR:
+    return result.uint32;
+  case VK_PERFORMANCE_COUNTER_STORAGE_UINT64_KHR:
+    return (double)result.uint64;
+  case VK_PERFORMANCE_COUNTER_STORAGE_FLOAT32_KHR:
+    return result.float32;
+  default:
+    return result.float64;
+  }
+}
+
+} // namespace
+
+void dispatch_counters::create(gpu_system &gpu) {
+  device_ = gpu.logical_device_handle;
+
+  // 1. Pipeline statistics: just the invocation count
+  if (gpu.pipeline_statistics_supported) {
+    VkQueryPoolCreateInfo info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    info.queryCount = 1;
+    info.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    VK_CHECK(vkCreateQueryPool(device_, &info, nullptr, &statistics_pool_));
+  }
+
+  if (!gpu.performance_query_supported)
+    return;
+  using enumerate_fn_type =
+      PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR;
+  using passes_fn_type =
+      PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR;
+  auto enumerate_fn = reinterpret_cast<enumerate_fn_type>(vkGetInstanceProcAddr(
+      gpu.instance_handle,
+      "vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR"));
+  auto passes_fn = reinterpret_cast<passes_fn_type>(vkGetInstanceProcAddr(
+      gpu.instance_handle,
+      "vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR"));
+  auto acquire_fn = reinterpret_cast<PFN_vkAcquireProfilingLockKHR>(
+      vkGetDeviceProcAddr(device_, "vkAcquireProfilingLockKHR"));
+  reset_pool_fn_ = reinterpret_cast<PFN_vkResetQueryPoolEXT>(
+      vkGetDeviceProcAddr(device_, "vkResetQueryPoolEXT"));
+  release_lock_fn_ = reinterpret_cast<PFN_vkReleaseProfilingLockKHR>(
+      vkGetDeviceProcAddr(device_, "vkReleaseProfilingLockKHR"));
+  if (!enumerate_fn || !passes_fn || !acquire_fn || !reset_pool_fn_ ||
+      !release_lock_fn_)
+    return;
+
+  // 2. Every counter the compute family has
+  VkPhysicalDevice phys = gpu.physical_device_handle;
+  uint32_t family = gpu.compute_queue_family_index;
+  uint32_t available = 0;
+  enumerate_fn(phys, family, &available, nullptr, nullptr);
+  std::vector<VkPerformanceCounterKHR> counters(
+      available, {VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR});
+  std::vector<VkPerformanceCounterDescriptionKHR> descriptions(
+      available, {VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR});
+  enumerate_fn(phys, family, &available, counters.data(),
+               descriptions.data());
+
+  // 3. The wanted ones, as long as all of them still fit in one pass
+  std::vector<uint32_t> picked;
+  VkQueryPoolPerformanceCreateInfoKHR perf_info{
+      VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR};
+  perf_info.queueFamilyIndex = family;
+  for (uint32_t i = 0; i < available; i++) {
+    if (counters[i].scope == VK_PERFORMANCE_COUNTER_SCOPE_RENDER_PASS_KHR)
+      continue;
+    std::string text = lower(std::string(descriptions[i].name) + " " +
+                             descriptions[i].category + " " +
+                             descriptions[i].description);
+    bool match = std::any_of(wanted.begin(), wanted.end(),
+                             [&](const std::string &keyword) {
+                               return text.find(lower(keyword)) !=
+                                      std::string::npos;
+                             });
+    if (!match)
+      continue;
+    picked.push_back(i);
+    perf_info.counterIndexCount = (uint32_t)picked.size();
+    perf_info.pCounterIndices = picked.data();
+    uint32_t passes = 0;
+    passes_fn(phys, &perf_info, &passes);
+    if (passes != 1) {
+      picked.pop_back();
+      continue;
+    }
+    performance_counters_.push_back(
+        {descriptions[i].name, unit_name(counters[i].unit), 0.0});
+    storage_.push_back(counters[i].storage);
+  }
+  if (picked.empty())
+    return;
+
+  // 4. The pool, and the lock recording it requires; without the lock the
+  // run carries on with pipeline statistics only
+  if (!acquire_profiling_lock(device_, acquire_fn)) {
+    std::cerr << "dispatch_counters: profiling lock unavailable, "
+                 "performance counters skipped"
+              << std::endl;
+    performance_counters_.clear();
+    storage_.clear();
+    release_lock_fn_ = nullptr;
+    return;
+  }
+  perf_info.counterIndexCount = (uint32_t)picked.size();
+  perf_info.pCounterIndices = picked.data();
+  VkQueryPoolCreateInfo info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  info.pNext = &perf_info;
+  info.queryType = VK_QUERY_TYPE_PERFORMANCE_QUERY_KHR;
+  info.queryCount = 1;
+  VK_CHECK(vkCreateQueryPool(device_, &info, nullptr, &performance_pool_));
+}
+
+void dispatch_counters::reset() {
+  if (performance_pool_ != VK_NULL_HANDLE)
+    reset_pool_fn_(device_, performance_pool_, 0, 1);
+}
+
+void dispatch_counters::begin(VkCommandBuffer cb) {
+  if (performance_pool_ != VK_NULL_HANDLE) {
+    reset();
+    vkCmdBeginQuery(cb, performance_pool_, 0, 0);
+  }
+  if (statistics_pool_ != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cb, statistics_pool_, 0, 1);
+    vkCmdBeginQuery(cb, statistics_pool_, 0, 0);
+  }
+}
+
+void dispatch_counters::end(VkCommandBuffer cb) {
+  if (statistics_pool_ != VK_NULL_HANDLE)
+    vkCmdEndQuery(cb, statistics_pool_, 0);
+  if (performance_pool_ != VK_NULL_HANDLE)
+    vkCmdEndQuery(cb, performance_pool_, 0);
+}
+
+std::vector<counter_value> dispatch_counters::results() {
+  std::vector<counter_value> values;
+  if (statistics_pool_ != VK_NULL_HANDLE) {
+    uint64_t invocations = 0;
+    vkGetQueryPoolResults(device_, statistics_pool_, 0, 1,
+                          sizeof(invocations), &invocations,
+                          sizeof(invocations),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    values.push_back({"compute_invocations", "", (double)invocations});
+  }
+  if (performance_pool_ != VK_NULL_HANDLE) {
+    // Performance results come as a union per counter; no 64_BIT flag
+    std::vector<VkPerformanceCounterResultKHR> raw(storage_.size());
+    VkDeviceSize bytes = raw.size() * sizeof(VkPerformanceCounterResultKHR);
+    vkGetQueryPoolResults(device_, performance_pool_, 0, 1, bytes, raw.data(),
+                          bytes, VK_QUERY_RESULT_WAIT_BIT);
+    for (size_t i = 0; i < raw.size(); i++) {
+      counter_value value = performance_counters_[i];
+      value.value = as_double(raw[i], storage_[i]);
+      values.push_back(value);
+    }
+  }
+  return values;
+}
+
+std::vector<std::string> dispatch_counters::names() const {
+  std::vector<std::string> out;
+  if (statistics_pool_ != VK_NULL_HANDLE)
+    out.push_back("compute_invocations");
+  if (performance_pool_ != VK_NULL_HANDLE)
+    for (const counter_value &counter : performance_counters_)
+      out.push_back(counter.name);
+  return out;
+}
+
+void dispatch_counters::destroy() {
+  if (statistics_pool_ != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device_, statistics_pool_, nullptr);
+  if (performance_pool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_, performance_pool_, nullptr);
+    release_profiling_lock(device_, release_lock_fn_);
+  }
+  statistics_pool_ = VK_NULL_HANDLE;
+  performance_pool_ = VK_NULL_HANDLE;
+  performance_counters_.clear();
+  storage_.clear();
+}
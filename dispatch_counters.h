@@ -0,0 +1,75 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One counter read back after a dispatch.
+struct counter_value {
+  std::string name; // "compute_invocations", or the driver's counter name
+  std::string unit; // "", "%", "ns", "bytes", "cycles", ...
+  double value = 0.0;
+};
+
+// Hardware counters around a dispatch, the timer's companion for "why"
+// rather than "how long". Whatever the device offers is collected and the
+// rest is skipped, so the same run works on lavapipe (invocations only, or
+// nothing at all) and on drivers with full VK_KHR_performance_query:
+// - compute_invocations from a pipeline-statistics query
+// - performance counters whose name, category or description matches one of
+//   `wanted`, as many as the driver can collect in a single pass
+// shader_pipeline::record() brackets its dispatch with begin() / end() when
+// handed one; the performance query must then be the first command in the
+// command buffer, as the extension demands.
+class dispatch_counters {
+public:
+  // Case-insensitive keywords picking performance counters.
+  std::vector<std::string> wanted = {"cache", "hit",   "miss", "dram",
+                                     "memory", "stall", "l1",   "l2"};
+
+  void create(gpu_system &gpu);
+
+  // Records the start / end of the counted range.
+  void begin(VkCommandBuffer command_buffer);
+  void end(VkCommandBuffer command_buffer);
+
+  // Performance queries cannot be reset inside the command buffer that uses
+  // them, so begin() resets them from the host. Call this before every
+  // resubmission of an already recorded command buffer.
+  void reset();
+
+  // Waits for the last submission and reads every counter back.
+  std::vector<counter_value> results();
+
+  // Counters results() reports, in order; empty when nothing is supported.
+  std::vector<std::string> names() const;
+
+  void destroy();
+
+private:
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkQueryPool statistics_pool_ = VK_NULL_HANDLE;
+  VkQueryPool performance_pool_ = VK_NULL_HANDLE;
+  std::vector<counter_value> performance_counters_; // names and units
+  std::vector<VkPerformanceCounterStorageKHR> storage_;
+  PFN_vkResetQueryPoolEXT reset_pool_fn_ = nullptr;
+  PFN_vkReleaseProfilingLockKHR release_lock_fn_ = nullptr;
+};
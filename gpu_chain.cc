@@ -0,0 +1,186 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "gpu_chain.h"
+#include "app_structures.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+static_assert(sizeof(chain_permutation) == 36,
+              "chain_permutation must match chain_build.comp's Params");
+
+chain_permutation chain_permutation::make(uint32_t words, chain_layout layout,
+                                          uint64_t seed) {
+  if (words == 0)
+    throw std::invalid_argument("chain_permutation: empty chain");
+  chain_permutation perm;
+  perm.words = words;
+  perm.stride = layout == chain_layout::line_random ? 16 : 1;
+  perm.count = (uint32_t)(((uint64_t)words + perm.stride - 1) / perm.stride);
+  while (perm.half_bits < 16 &&
+         (uint64_t(1) << (2 * perm.half_bits)) < perm.count)
+    perm.half_bits++;
+  // Four rounds of a good mixer leave no pattern a prefetcher can follow;
+  // the sequential layout keeps the identity.
+  perm.rounds = layout == chain_layout::sequential ? 0 : 4;
+  std::mt19937_64 g(seed);
+  for (uint32_t &key : perm.keys)
+    key = (uint32_t)g();
+  return perm;
+}
+
+uint32_t chain_permutation::operator()(uint32_t i) const {
+  auto feistel = [this](uint32_t x) {
+    uint32_t mask = (1u << half_bits) - 1u;
+    uint32_t left = x >> half_bits, right = x & mask;
+    for (uint32_t r = 0; r < rounds; r++) {
+      uint32_t next = left ^ (hash_key(right ^ keys[r]) & mask);
+      left = right;
+      right = next;
+    }
+    return (left << half_bits) | right;
+  };
+  uint32_t x = feistel(i);
+  while (x >= count)
+    x = feistel(x);
+  return x;
+}
+
+void build_permuted_chain(uint32_t *data, const chain_permutation &perm) {
+  std::fill(data, data + perm.words, 0u);
+  for (uint32_t i = 0; i < perm.count; i++) {
+    uint32_t next = perm(i + 1 == perm.count ? 0 : i + 1);
+    data[(size_t)perm(i) * perm.stride] = next * perm.stride;
+  }
+}
+
+void gpu_chain_builder::create(gpu_system &gpu, uint32_t queue_index) {
+  gpu_ = &gpu;
+  queue_ = gpu.compute_queues.at(queue_index);
+  VkDevice dev = gpu.logical_device_handle;
+
+  // 1. One pipeline per MODE
+  builder_.specialization_constants = {0};
+  builder_.prepare(dev, "chain_build.spv", gpu.push_descriptor_supported);
+  checker_.specialization_constants = {1};
+  checker_.prepare(dev, "chain_build.spv", gpu.push_descriptor_supported);
+  unused_check_.create(dev, gpu.physical_device_handle, 4 * sizeof(uint32_t),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // 2. Command objects, reused by every build and check
+  stopwatch_.create(dev, gpu.physical_device_handle);
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+  VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &command_pool_));
+  VkCommandBufferAllocateInfo cb_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cb_info.commandPool = command_pool_;
+  cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cb_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &command_buffer_));
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &fence_));
+}
+
+double gpu_chain_builder::submit(shader_pipeline &pipeline,
+                                 memory_block &nodes, memory_block &check,
+                                 const chain_permutation &perm) {
+  VkDevice dev = gpu_->logical_device_handle;
+
+  // 1. Enough invocations for one node each, within the dispatch limit;
+  // the kernel strides over whatever is left
+  pipeline.group_count_x = std::max<uint32_t>(
+      1, std::min<uint32_t>(
+             (perm.count + 255) / 256,
+             gpu_->device_properties.limits.maxComputeWorkGroupCount[0]));
+  pipeline.push_constants.resize(sizeof(perm));
+  std::memcpy(pipeline.push_constants.data(), &perm, sizeof(perm));
+  pipeline.bind_blocks(dev, {&nodes, &check});
+
+  // 2. Record, submit and wait
+  VK_CHECK(vkResetCommandPool(dev, command_pool_, 0));
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(command_buffer_, &begin_info);
+  pipeline.record(command_buffer_, stopwatch_);
+  vkEndCommandBuffer(command_buffer_);
+
+  VK_CHECK(vkResetFences(dev, 1, &fence_));
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &command_buffer_;
+  VK_CHECK(vkQueueSubmit(queue_, 1, &submit_info, fence_));
+  VK_CHECK(vkWaitForFences(dev, 1, &fence_, VK_TRUE, UINT64_MAX));
+  return stopwatch_.get_nanoseconds(dev);
+}
+
+double gpu_chain_builder::build(memory_block &nodes, uint32_t words,
+                                chain_layout layout, uint64_t seed) {
+  return submit(builder_, nodes, unused_check_,
+                chain_permutation::make(words, layout, seed));
+}
+
+uint32_t gpu_chain_builder::verify(memory_block &nodes, uint32_t words,
+                                   chain_layout layout, uint64_t seed) {
+  chain_permutation perm = chain_permutation::make(words, layout, seed);
+
+  // 1. Two counters and the visited bitmap, cleared from the host
+  VkDeviceSize bytes =
+      (2 + (VkDeviceSize(perm.count) + 31) / 32) * sizeof(uint32_t);
+  memory_block check;
+  check.create(gpu_->logical_device_handle, gpu_->physical_device_handle,
+               bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::memset(check.map(VK_NULL_HANDLE), 0, bytes);
+  check.unmap(VK_NULL_HANDLE);
+
+  // 2. Check, then read the counters back
+  submit(checker_, nodes, check, perm);
+  const uint32_t *counters =
+      reinterpret_cast<const uint32_t *>(check.map(VK_NULL_HANDLE));
+  uint32_t errors = counters[0];
+  if (errors > 0)
+    std::cerr << "chain check: " << errors << " bad nodes, e.g. word "
+              << counters[1] << std::endl;
+  check.unmap(VK_NULL_HANDLE);
+  check.destroy(VK_NULL_HANDLE);
+  return errors;
+}
+
+void gpu_chain_builder::destroy() {
+  if (gpu_ == nullptr)
+    return;
+  VkDevice dev = gpu_->logical_device_handle;
+  vkDestroyFence(dev, fence_, nullptr);
+  vkDestroyCommandPool(dev, command_pool_, nullptr);
+  stopwatch_.destroy(dev);
+  unused_check_.destroy(VK_NULL_HANDLE);
+  builder_.destroy(dev);
+  checker_.destroy(dev);
+  fence_ = VK_NULL_HANDLE;
+  command_pool_ = VK_NULL_HANDLE;
+  command_buffer_ = VK_NULL_HANDLE;
+  gpu_ = nullptr;
+  queue_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,85 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include "utils.h"
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+// The chain chain_build.comp makes for (words, layout, seed), as the push
+// constants it takes. The chain is not the one build_chain makes for the
+// same seed: it comes from a keyed bijection instead of a shuffle, so the
+// GPU can compute every link on its own.
+struct chain_permutation {
+  uint32_t keys[4] = {};  // one per Feistel round
+  uint32_t words = 0;     // uint32_t nodes in the buffer
+  uint32_t count = 0;     // chain nodes: words, or lines for line_random
+  uint32_t stride = 1;    // words from one chain node to the next
+  uint32_t half_bits = 1; // Feistel half width; 4^half_bits >= count
+  uint32_t rounds = 0;    // 0 = identity, for the sequential layout
+
+  static chain_permutation make(uint32_t words, chain_layout layout,
+                                uint64_t seed);
+
+  // The chain node visited i-th (i < count), computed as the kernel does.
+  uint32_t operator()(uint32_t i) const;
+};
+
+// Host copy of what chain_build.comp writes, for checking the kernel or
+// filling small host-visible chains the same way.
+void build_permuted_chain(uint32_t *data, const chain_permutation &perm);
+
+// Builds and checks chains in device memory with chain_build.comp. The nodes
+// buffer may be of any memory type, including device-local memory the host
+// cannot map, and a 1GB chain takes milliseconds instead of the seconds a
+// host shuffle and copy do.
+class gpu_chain_builder {
+public:
+  // Submissions go to gpu.compute_queues[queue_index], and wait there.
+  void create(gpu_system &gpu, uint32_t queue_index = 0);
+
+  // Writes the chain over the first `words` uint32_t of `nodes` (created
+  // with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT). Returns the GPU nanoseconds
+  // it took.
+  double build(memory_block &nodes, uint32_t words, chain_layout layout,
+               uint64_t seed);
+
+  // Re-derives the chain over `nodes` and returns the number of nodes with a
+  // wrong link or visited twice: 0 means one cycle through every chain
+  // node, each visited once. Needs a words / 8 byte bitmap for the duration.
+  uint32_t verify(memory_block &nodes, uint32_t words, chain_layout layout,
+                  uint64_t seed);
+
+  void destroy();
+
+private:
+  double submit(shader_pipeline &pipeline, memory_block &nodes,
+                memory_block &check, const chain_permutation &perm);
+
+  gpu_system *gpu_ = nullptr;
+  VkQueue queue_ = VK_NULL_HANDLE;
+  shader_pipeline builder_, checker_;
+  memory_block unused_check_; // bound to binding 1 while building
+  timer stopwatch_;
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+  VkFence fence_ = VK_NULL_HANDLE;
+};
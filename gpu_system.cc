@@ -17,86 +17,342 @@
  */
 
 #include "gpu_system.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
-void gpu_system::initialize() {
-  // 1. Instance Setup (The Mac "Secret Sauce")
+namespace {
+
+// 1. Instance Setup (The Mac "Secret Sauce")
+VkInstance create_instance() {
+  // Portability enumeration is what makes MoltenVK show up at all; loaders
+  // that predate it (older Linux distros) reject the name, so only ask for
+  // it when it is offered.
+  uint32_t ext_count = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &ext_count, nullptr);
+  std::vector<VkExtensionProperties> available(ext_count);
+  vkEnumerateInstanceExtensionProperties(nullptr, &ext_count,
+                                         available.data());
+  auto has_extension = [&](const char *name) {
+    for (const VkExtensionProperties &ext : available)
+      if (std::strcmp(ext.extensionName, name) == 0)
+        return true;
+    return false;
+  };
+
   std::vector<const char *> extensions = {
-      VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
       VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
 
   VkInstanceCreateInfo inst_info{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
-  inst_info.flags |=
-      VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR; // Critical for Mac
+  if (has_extension(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+    inst_info.flags |=
+        VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR; // Critical for Mac
+  }
   inst_info.enabledExtensionCount = (uint32_t)extensions.size();
   inst_info.ppEnabledExtensionNames = extensions.data();
 
-  if (vkCreateInstance(&inst_info, nullptr, &instance_handle) != VK_SUCCESS) {
+  VkInstance instance = VK_NULL_HANDLE;
+  if (vkCreateInstance(&inst_info, nullptr, &instance) != VK_SUCCESS) {
     throw std::runtime_error(
         "GpuSystem: Failed to create Instance. Is MoltenVK installed?");
   }
+  return instance;
+}
 
-  // 2. Pick the M4 Max
+std::vector<VkPhysicalDevice> physical_devices(VkInstance instance) {
   uint32_t device_count = 0;
-  vkEnumeratePhysicalDevices(instance_handle, &device_count, nullptr);
+  vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
   std::vector<VkPhysicalDevice> devices(device_count);
-  vkEnumeratePhysicalDevices(instance_handle, &device_count, devices.data());
+  vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+  return devices;
+}
+
+// deviceUUID through VK_KHR_get_physical_device_properties2, which
+// create_instance() always enables.
+std::string read_device_uuid(VkInstance instance, VkPhysicalDevice device) {
+  auto get_properties2 =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+          vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+  if (get_properties2 == nullptr)
+    return "";
+  VkPhysicalDeviceIDPropertiesKHR id_props{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR};
+  VkPhysicalDeviceProperties2KHR props2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR};
+  props2.pNext = &id_props;
+  get_properties2(device, &props2);
+
+  static const char hex[] = "0123456789abcdef";
+  std::string out;
+  for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+    out += hex[id_props.deviceUUID[i] >> 4];
+    out += hex[id_props.deviceUUID[i] & 0xF];
+  }
+  return out;
+}
+
+std::vector<VkQueueFamilyProperties> queue_families(VkPhysicalDevice device) {
+  uint32_t q_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &q_count, nullptr);
+  std::vector<VkQueueFamilyProperties> q_props(q_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &q_count, q_props.data());
+  return q_props;
+}
+
+} // namespace
+
+std::vector<gpu_description> gpu_system::enumerate() {
+  VkInstance instance = create_instance();
+  std::vector<gpu_description> result;
+
+  std::vector<VkPhysicalDevice> devices = physical_devices(instance);
+  for (uint32_t d = 0; d < devices.size(); d++) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(devices[d], &props);
+
+    gpu_description desc;
+    desc.device_index = d;
+    desc.name = props.deviceName;
+    desc.device_type = props.deviceType;
+    desc.driver_version = props.driverVersion;
+    desc.uuid = read_device_uuid(instance, devices[d]);
+
+    std::vector<VkQueueFamilyProperties> q_props = queue_families(devices[d]);
+    for (uint32_t i = 0; i < q_props.size(); i++) {
+      if ((q_props[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+          q_props[i].timestampValidBits != 0) {
+        desc.compute_queue_families.push_back(i);
+        desc.compute_queue_counts.push_back(q_props[i].queueCount);
+      }
+    }
+    result.push_back(desc);
+  }
+
+  vkDestroyInstance(instance, nullptr);
+  return result;
+}
+
+uint32_t gpu_system::find_device(const std::string &index_or_name) {
+  if (!index_or_name.empty() &&
+      std::all_of(index_or_name.begin(), index_or_name.end(), ::isdigit))
+    return (uint32_t)std::stoul(index_or_name);
+
+  std::vector<uint32_t> matches;
+  for (const gpu_description &desc : enumerate())
+    if (desc.name.find(index_or_name) != std::string::npos)
+      matches.push_back(desc.device_index);
+  if (matches.size() != 1)
+    throw std::runtime_error("GpuSystem: " + std::to_string(matches.size()) +
+                             " devices match \"" + index_or_name + "\"");
+  return matches[0];
+}
+
+void gpu_system::initialize(uint32_t device_idx, uint32_t queue_family,
+                            uint32_t queue_count) {
+  instance_handle = create_instance();
+
+  // 2. Pick the M4 Max (or whichever device was asked for)
+  std::vector<VkPhysicalDevice> devices = physical_devices(instance_handle);
 
   if (devices.empty())
     throw std::runtime_error("GpuSystem: No GPUs found!");
-  physical_device_handle = devices[0];
+  if (device_idx >= devices.size())
+    throw std::runtime_error("GpuSystem: No device at index " +
+                             std::to_string(device_idx));
+  physical_device_handle = devices[device_idx];
+  device_index = device_idx;
+  vkGetPhysicalDeviceProperties(physical_device_handle, &device_properties);
+  device_uuid = read_device_uuid(instance_handle, physical_device_handle);
 
   // 3. Find the Compute Queue
-  uint32_t q_count = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_handle, &q_count,
-                                           nullptr);
-  std::vector<VkQueueFamilyProperties> q_props(q_count);
-  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_handle, &q_count,
-                                           q_props.data());
+  std::vector<VkQueueFamilyProperties> q_props =
+      queue_families(physical_device_handle);
+  uint32_t q_count = (uint32_t)q_props.size();
 
   bool found = false;
   for (uint32_t i = 0; i < q_count; i++) {
-    if (q_props[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
-      compute_queue_family_index = i;
-      found = true;
-      // --- NEW: Check for Timestamp Support ---
-      timestamp_valid_bits = q_props[i].timestampValidBits;
-
-      if (timestamp_valid_bits == 0) {
-        throw std::runtime_error(
-            "GpuSystem: Selected queue does not support timestamps!");
-      }
-
-      break;
+    if (queue_family != any_queue_family && i != queue_family)
+      continue;
+    if (!(q_props[i].queueFlags & VK_QUEUE_COMPUTE_BIT))
+      continue;
+    // Every measurement is timed on the queue, so a family without
+    // timestamps is passed over, or refused when it was asked for by index.
+    if (q_props[i].timestampValidBits == 0) {
+      if (queue_family == any_queue_family)
+        continue;
+      throw std::runtime_error(
+          "GpuSystem: Selected queue does not support timestamps!");
     }
+    compute_queue_family_index = i;
+    timestamp_valid_bits = q_props[i].timestampValidBits;
+    found = true;
+    break;
   }
   if (!found)
-    throw std::runtime_error("GpuSystem: No Compute Queue found!");
+    throw std::runtime_error(
+        "GpuSystem: No Compute Queue with timestamps found!");
 
   // 4. Logical Device (The Subset requirement)
-  float priority = 1.0f;
+  // Every queue gets the same priority so none is favoured when several
+  // chasers run side by side.
+  uint32_t family_queues = q_props[compute_queue_family_index].queueCount;
+  queue_count = std::max(1u, std::min(queue_count, family_queues));
+
+  // A queue for copies next to the compute work: a dedicated DMA family
+  // (transfer without graphics or compute) if there is one, else any other
+  // family (graphics and compute families can all copy), else a spare queue
+  // of the compute family.
+  uint32_t transfer_family = any_queue_family;
+  transfer_queue_dedicated = false;
+  for (uint32_t i = 0; i < q_count; i++) {
+    VkQueueFlags flags = q_props[i].queueFlags;
+    if (i == compute_queue_family_index || q_props[i].queueCount == 0)
+      continue;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      transfer_family = i;
+      transfer_queue_dedicated = true;
+      break;
+    }
+    if (transfer_family == any_queue_family &&
+        (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT |
+                  VK_QUEUE_COMPUTE_BIT)))
+      transfer_family = i;
+  }
+  bool spare_compute_queue =
+      transfer_family == any_queue_family && queue_count < family_queues;
+
+  std::vector<float> priorities(queue_count + 1, 1.0f);
+  std::vector<VkDeviceQueueCreateInfo> q_infos;
   VkDeviceQueueCreateInfo q_info{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
   q_info.queueFamilyIndex = compute_queue_family_index;
-  q_info.queueCount = 1;
-  q_info.pQueuePriorities = &priority;
+  q_info.queueCount = queue_count + (spare_compute_queue ? 1 : 0);
+  q_info.pQueuePriorities = priorities.data();
+  q_infos.push_back(q_info);
+  if (transfer_family != any_queue_family) {
+    q_info.queueFamilyIndex = transfer_family;
+    q_info.queueCount = 1;
+    q_infos.push_back(q_info);
+  }
+
+  // Only ask for extensions the device actually reports; vkCreateDevice
+  // fails outright on an unknown name.
+  uint32_t ext_count = 0;
+  vkEnumerateDeviceExtensionProperties(physical_device_handle, nullptr,
+                                       &ext_count, nullptr);
+  std::vector<VkExtensionProperties> available(ext_count);
+  vkEnumerateDeviceExtensionProperties(physical_device_handle, nullptr,
+                                       &ext_count, available.data());
+  auto has_extension = [&](const char *name) {
+    for (const VkExtensionProperties &ext : available)
+      if (std::strcmp(ext.extensionName, name) == 0)
+        return true;
+    return false;
+  };
 
   // This extension is the "buddy" to the Instance portability flag
-  std::vector<const char *> dev_ext = {"VK_KHR_portability_subset"};
+  std::vector<const char *> dev_ext;
+  if (has_extension("VK_KHR_portability_subset"))
+    dev_ext.push_back("VK_KHR_portability_subset");
+
+  // Lets shader_pipeline write descriptors straight into the command buffer
+  push_descriptor_supported =
+      has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  if (push_descriptor_supported)
+    dev_ext.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+  // Counters for dispatch_counters; runs go on without them (lavapipe, say)
+  VkPhysicalDeviceFeatures supported{}, enabled{};
+  vkGetPhysicalDeviceFeatures(physical_device_handle, &supported);
+  pipeline_statistics_supported = supported.pipelineStatisticsQuery;
+  enabled.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+
+  // Extension features: each struct is chained only when its extension is
+  // there, queried, then chained again for vkCreateDevice only if usable.
+  VkPhysicalDevicePerformanceQueryFeaturesKHR perf_features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PERFORMANCE_QUERY_FEATURES_KHR};
+  VkPhysicalDeviceHostQueryResetFeaturesEXT reset_features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES_EXT};
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR};
+  void *chain = nullptr;
+  auto link = [&chain](auto &features) {
+    features.pNext = chain;
+    chain = &features;
+  };
+  auto get_features2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+      vkGetInstanceProcAddr(instance_handle,
+                            "vkGetPhysicalDeviceFeatures2KHR"));
+  bool has_perf = get_features2 &&
+                  has_extension(VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME) &&
+                  has_extension(VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME);
+  bool has_timeline =
+      get_features2 && has_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  if (has_perf) {
+    link(reset_features);
+    link(perf_features);
+  }
+  if (has_timeline)
+    link(timeline_features);
+  if (chain) {
+    VkPhysicalDeviceFeatures2KHR features2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR};
+    features2.pNext = chain;
+    get_features2(physical_device_handle, &features2);
+  }
+  performance_query_supported = has_perf &&
+                                perf_features.performanceCounterQueryPools &&
+                                reset_features.hostQueryReset;
+  timeline_semaphore_supported =
+      has_timeline && timeline_features.timelineSemaphore;
+
+  chain = nullptr;
+  if (performance_query_supported) {
+    dev_ext.push_back(VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME);
+    dev_ext.push_back(VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME);
+    // Enable only what is used
+    perf_features.performanceCounterMultipleQueryPools = VK_FALSE;
+    link(reset_features);
+    link(perf_features);
+  }
+  if (timeline_semaphore_supported) {
+    dev_ext.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    link(timeline_features);
+  }
 
   VkDeviceCreateInfo dev_info{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-  dev_info.queueCreateInfoCount = 1;
-  dev_info.pQueueCreateInfos = &q_info;
+  dev_info.pNext = chain;
+  dev_info.queueCreateInfoCount = (uint32_t)q_infos.size();
+  dev_info.pQueueCreateInfos = q_infos.data();
   dev_info.enabledExtensionCount = (uint32_t)dev_ext.size();
   dev_info.ppEnabledExtensionNames = dev_ext.data();
+  dev_info.pEnabledFeatures = &enabled;
 
   if (vkCreateDevice(physical_device_handle, &dev_info, nullptr,
                      &logical_device_handle) != VK_SUCCESS) {
     throw std::runtime_error("GpuSystem: Failed to create Logical Device!");
   }
 
-  vkGetDeviceQueue(logical_device_handle, compute_queue_family_index, 0,
-                   &compute_queue_handle);
+  compute_queues.resize(queue_count);
+  for (uint32_t i = 0; i < queue_count; i++)
+    vkGetDeviceQueue(logical_device_handle, compute_queue_family_index, i,
+                     &compute_queues[i]);
+  compute_queue_handle = compute_queues[0];
+
+  transfer_queue_handle = VK_NULL_HANDLE;
+  if (transfer_family != any_queue_family) {
+    transfer_queue_family_index = transfer_family;
+    vkGetDeviceQueue(logical_device_handle, transfer_family, 0,
+                     &transfer_queue_handle);
+  } else if (spare_compute_queue) {
+    transfer_queue_family_index = compute_queue_family_index;
+    vkGetDeviceQueue(logical_device_handle, compute_queue_family_index,
+                     queue_count, &transfer_queue_handle);
+  }
 }
 
 void gpu_system::shutdown() {
@@ -104,4 +360,12 @@ void gpu_system::shutdown() {
     vkDestroyDevice(logical_device_handle, nullptr);
   if (instance_handle != VK_NULL_HANDLE)
     vkDestroyInstance(instance_handle, nullptr);
+  logical_device_handle = VK_NULL_HANDLE;
+  instance_handle = VK_NULL_HANDLE;
+  compute_queue_handle = VK_NULL_HANDLE;
+  compute_queues.clear();
+  transfer_queue_handle = VK_NULL_HANDLE;
+  pipeline_statistics_supported = false;
+  performance_query_supported = false;
+  timeline_semaphore_supported = false;
 }
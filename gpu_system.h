@@ -17,9 +17,30 @@
  */
 
 #pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
 #include <vulkan/vulkan.h>
+
+// What a device offers for compute, as seen before opening it.
+struct gpu_description {
+  uint32_t device_index = 0; // position in vkEnumeratePhysicalDevices
+  std::string name;
+  VkPhysicalDeviceType device_type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+  uint32_t driver_version = 0;
+  // VkPhysicalDeviceIDProperties::deviceUUID as 32 hex digits ("" if the
+  // driver does not report one); stable across reboots and device order.
+  std::string uuid;
+  // Families with VK_QUEUE_COMPUTE_BIT and timestamps, with queue counts
+  std::vector<uint32_t> compute_queue_families;
+  std::vector<uint32_t> compute_queue_counts;
+};
+
 // create a vulkan context
 struct gpu_system {
+  // Marker for initialize(): pick the first compute family with timestamps
+  static constexpr uint32_t any_queue_family = ~0u;
+
   VkInstance instance_handle =
       VK_NULL_HANDLE; // says going to use vulkan
                       // this is the physical logical_device or gpu/cpu
@@ -30,10 +51,47 @@ struct gpu_system {
   VkDevice logical_device_handle = VK_NULL_HANDLE;
   // logical_device queue would be a compute, fragment or vertex queue
   VkQueue compute_queue_handle = VK_NULL_HANDLE;
+  // All queues opened on the compute family; compute_queues[0] is the
+  // compute_queue_handle above.
+  std::vector<VkQueue> compute_queues;
   // This will be an int marker to compute queue for now
   uint32_t compute_queue_family_index = 0;
+  // A queue for copies beside the compute queues, VK_NULL_HANDLE when there
+  // is none: one of a dedicated transfer family if the device has one
+  // (transfer_queue_dedicated), else of another family, else a spare queue of
+  // the compute family.
+  VkQueue transfer_queue_handle = VK_NULL_HANDLE;
+  uint32_t transfer_queue_family_index = 0;
+  bool transfer_queue_dedicated = false;
   uint32_t timestamp_valid_bits = 0; // bits supported by the clock
+  // VK_KHR_push_descriptor was found and enabled on the logical device
+  bool push_descriptor_supported = false;
+  // Optional query features, enabled whenever the device offers them (see
+  // dispatch_counters): pipelineStatisticsQuery, and VK_KHR_performance_query
+  // together with host query reset, which its query pools need.
+  bool pipeline_statistics_supported = false;
+  bool performance_query_supported = false;
+  // VK_KHR_timeline_semaphore, enabled when offered
+  bool timeline_semaphore_supported = false;
+  // Name, type, limits and driver version of the selected device
+  VkPhysicalDeviceProperties device_properties{};
+  uint32_t device_index = 0;
+  std::string device_uuid; // as in gpu_description::uuid
 
-  void initialize();
+  // Opens device `device_index` with `queue_count` queues (clamped to what
+  // the family has) from `queue_family`. Defaults keep the original
+  // behaviour: first device, first compute family, one queue.
+  void initialize(uint32_t device_index = 0,
+                  uint32_t queue_family = any_queue_family,
+                  uint32_t queue_count = 1);
   void shutdown(); // Cleanup
+
+  // Lists every physical device and its compute queue families. Uses a
+  // short-lived instance of its own, so it can be called at any time.
+  static std::vector<gpu_description> enumerate();
+
+  // Device index for a command-line spec: a number is taken as is, anything
+  // else must be part of exactly one device name ("llvmpipe", "M4").
+  // Throws std::runtime_error when nothing (or more than one) matches.
+  static uint32_t find_device(const std::string &index_or_name);
 };
@@ -0,0 +1,138 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "host_buffer.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+size_t round_up(size_t bytes, size_t granule) {
+  return (bytes + granule - 1) / granule * granule;
+}
+
+void *map_anonymous(size_t bytes, int extra_flags) {
+  void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+  return p == MAP_FAILED ? nullptr : p;
+}
+
+} // namespace
+
+const char *page_backing_name(page_backing backing) {
+  switch (backing) {
+  case page_backing::transparent_huge:
+    return "thp";
+  case page_backing::explicit_huge:
+    return "hugetlb";
+  default:
+    return "regular";
+  }
+}
+
+host_buffer::~host_buffer() { destroy(); }
+
+host_buffer::host_buffer(host_buffer &&other) noexcept
+    : data(other.data), size(other.size), backing(other.backing),
+      numa_binding(std::move(other.numa_binding)),
+      mapped_size_(other.mapped_size_) {
+  other.data = nullptr;
+  other.size = 0;
+  other.mapped_size_ = 0;
+}
+
+host_buffer &host_buffer::operator=(host_buffer &&other) noexcept {
+  if (this != &other) {
+    destroy();
+    data = other.data;
+    size = other.size;
+    backing = other.backing;
+    numa_binding = std::move(other.numa_binding);
+    mapped_size_ = other.mapped_size_;
+    other.data = nullptr;
+    other.size = 0;
+    other.mapped_size_ = 0;
+  }
+  return *this;
+}
+
+void host_buffer::create(size_t bytes, page_backing requested,
+                         const numa_placement &placement, int home_cpu) {
+  destroy();
+  if (bytes == 0)
+    throw std::runtime_error("host_buffer: zero-sized allocation");
+
+  // 1. Reserved huge pages, if asked for and available
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  if (requested == page_backing::explicit_huge) {
+    mapped_size_ = round_up(bytes, huge_page_size);
+    data = map_anonymous(mapped_size_, MAP_HUGETLB);
+    if (data) {
+      size = bytes;
+      backing = page_backing::explicit_huge;
+      numa_binding = bind_numa_range(data, mapped_size_, placement, home_cpu);
+      return;
+    }
+    requested = page_backing::transparent_huge; // pool empty or too small
+  }
+#endif
+
+  // 2. Ordinary pages. For THP, over-allocate so the range can be aligned to
+  // a huge-page boundary, which the kernel needs before it can back it.
+  bool want_thp = requested != page_backing::regular;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t align = want_thp ? huge_page_size : page;
+  size_t span = round_up(bytes, align) + (align > page ? align : 0);
+  char *raw = static_cast<char *>(map_anonymous(span, 0));
+  if (!raw)
+    throw std::runtime_error("host_buffer: mmap of " + std::to_string(bytes) +
+                             " bytes failed");
+
+  char *start = reinterpret_cast<char *>(
+      round_up(reinterpret_cast<size_t>(raw), align));
+  mapped_size_ = round_up(bytes, align);
+  if (start > raw)
+    munmap(raw, start - raw);
+  char *end = start + mapped_size_;
+  if (end < raw + span)
+    munmap(end, raw + span - end);
+
+  data = start;
+  size = bytes;
+  backing = page_backing::regular;
+  numa_binding = bind_numa_range(data, mapped_size_, placement, home_cpu);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (want_thp && madvise(data, mapped_size_, MADV_HUGEPAGE) == 0)
+    backing = page_backing::transparent_huge;
+#endif
+}
+
+void host_buffer::destroy() {
+  if (data)
+    munmap(data, mapped_size_);
+  data = nullptr;
+  size = 0;
+  mapped_size_ = 0;
+  backing = page_backing::regular;
+  numa_binding.clear();
+}
@@ -0,0 +1,69 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "numa.h"
+#include <cstddef>
+#include <string>
+
+// How the pages behind a host_buffer are backed.
+enum class page_backing {
+  regular,          // base pages (4 KB / 16 KB)
+  transparent_huge, // base pages plus a THP hint (madvise), Linux only
+  explicit_huge,    // MAP_HUGETLB from the reserved pool, Linux only
+};
+
+// "regular", "thp", "hugetlb"
+const char *page_backing_name(page_backing backing);
+
+// The host-side counterpart of memory_block: one page-aligned anonymous
+// allocation the CPU engines walk and stream through.
+// - explicit_huge needs pages reserved in /proc/sys/vm/nr_hugepages; when the
+//   pool cannot satisfy the request, create() falls back to the THP hint and
+//   records that in `backing`, so reports show what was actually measured.
+// - Memory is not touched here. Whoever touches it first decides (on NUMA
+//   machines) which node it lands on, so do that from the pinned thread.
+// - Move-only, freed by destroy() or the destructor.
+class host_buffer {
+public:
+  void *data = nullptr;
+  size_t size = 0;           // bytes asked for
+  page_backing backing = page_backing::regular; // what create() got
+  std::string numa_binding; // what create() bound, see bind_numa_range
+
+  host_buffer() = default;
+  ~host_buffer();
+  host_buffer(const host_buffer &) = delete;
+  host_buffer &operator=(const host_buffer &) = delete;
+  host_buffer(host_buffer &&other) noexcept;
+  host_buffer &operator=(host_buffer &&other) noexcept;
+
+  // Maps `bytes` of anonymous memory with the requested backing and binds it
+  // to `placement` (local/remote relative to `home_cpu`, -1 = the caller's
+  // CPU) before anything touches it; throws std::runtime_error if even
+  // regular pages are not available.
+  void create(size_t bytes, page_backing requested = page_backing::regular,
+              const numa_placement &placement = numa_placement(),
+              int home_cpu = -1);
+
+  template <typename T> T *as() { return static_cast<T *>(data); }
+
+  void destroy();
+
+private:
+  size_t mapped_size_ = 0; // size rounded up to the page size used
+};
@@ -0,0 +1,227 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "image_block.h"
+#include "memory_block.h"
+#include "utils.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+image_block::~image_block() { destroy(); }
+
+image_block::image_block(image_block &&other) noexcept { take(other); }
+
+image_block &image_block::operator=(image_block &&other) noexcept {
+  if (this != &other) {
+    destroy();
+    take(other);
+  }
+  return *this;
+}
+
+void image_block::take(image_block &other) {
+  image_handle = other.image_handle;
+  memory_handle = other.memory_handle;
+  view_handle = other.view_handle;
+  sampler_handle = other.sampler_handle;
+  format = other.format;
+  width = other.width;
+  height = other.height;
+  creation_serial = other.creation_serial;
+  device_handle_ = other.device_handle_;
+
+  other.image_handle = VK_NULL_HANDLE;
+  other.memory_handle = VK_NULL_HANDLE;
+  other.view_handle = VK_NULL_HANDLE;
+  other.sampler_handle = VK_NULL_HANDLE;
+  other.creation_serial = 0;
+  other.device_handle_ = VK_NULL_HANDLE;
+}
+
+void image_block::create(VkDevice logical_device,
+                         VkPhysicalDevice physical_device, VkImageType type,
+                         uint32_t image_width, uint32_t image_height,
+                         VkFormat image_format) {
+  destroy();
+  device_handle_ = logical_device;
+  format = image_format;
+  width = image_width;
+  height = type == VK_IMAGE_TYPE_1D ? 1 : image_height;
+  creation_serial = memory_block::next_creation_serial();
+
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(physical_device, format,
+                                      &format_properties);
+  if (!(format_properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    throw std::runtime_error(
+        "image_block: format cannot be sampled with optimal tiling");
+
+  // 1. The image itself
+  VkImageCreateInfo image_info{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  image_info.imageType = type;
+  image_info.format = format;
+  image_info.extent = {width, height, 1};
+  image_info.mipLevels = 1;
+  image_info.arrayLayers = 1;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage =
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VK_CHECK(vkCreateImage(device_handle_, &image_info, nullptr, &image_handle));
+
+  // 2. DEVICE_LOCAL memory for it
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(device_handle_, image_handle, &requirements);
+  VkPhysicalDeviceMemoryProperties mem_properties;
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+  uint32_t type_index = UINT32_MAX;
+  for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+    if ((requirements.memoryTypeBits & (1u << i)) &&
+        (mem_properties.memoryTypes[i].propertyFlags &
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+      type_index = i;
+      break;
+    }
+  }
+  if (type_index == UINT32_MAX) {
+    destroy();
+    throw std::runtime_error("image_block: no DEVICE_LOCAL memory type");
+  }
+  VkMemoryAllocateInfo alloc_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  alloc_info.allocationSize = requirements.size;
+  alloc_info.memoryTypeIndex = type_index;
+  VK_CHECK(
+      vkAllocateMemory(device_handle_, &alloc_info, nullptr, &memory_handle));
+  VK_CHECK(vkBindImageMemory(device_handle_, image_handle, memory_handle, 0));
+
+  // 3. A view over the whole image and a sampler that only ever fetches
+  VkImageViewCreateInfo view_info{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  view_info.image = image_handle;
+  view_info.viewType = type == VK_IMAGE_TYPE_1D ? VK_IMAGE_VIEW_TYPE_1D
+                                                : VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  VK_CHECK(
+      vkCreateImageView(device_handle_, &view_info, nullptr, &view_handle));
+
+  VkSamplerCreateInfo sampler_info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  VK_CHECK(vkCreateSampler(device_handle_, &sampler_info, nullptr,
+                           &sampler_handle));
+}
+
+void image_block::upload(VkPhysicalDevice physical_device, VkQueue queue,
+                         uint32_t queue_family_index, const void *texels,
+                         VkDeviceSize bytes) {
+  // 1. Stage the texels in host-visible memory
+  memory_block staging;
+  staging.create(device_handle_, physical_device, bytes,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::memcpy(staging.map(VK_NULL_HANDLE), texels, bytes);
+  staging.unmap(VK_NULL_HANDLE);
+
+  VkCommandPool pool;
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = queue_family_index;
+  VK_CHECK(vkCreateCommandPool(device_handle_, &pool_info, nullptr, &pool));
+  VkCommandBuffer cb;
+  VkCommandBufferAllocateInfo cb_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cb_info.commandPool = pool;
+  cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cb_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(device_handle_, &cb_info, &cb));
+
+  // 2. UNDEFINED -> TRANSFER_DST, copy, TRANSFER_DST -> SHADER_READ_ONLY
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cb, &begin_info);
+
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image_handle;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {width, height, 1};
+  vkCmdCopyBufferToImage(cb, staging.logical_memory_block_handle,
+                         image_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                         &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  vkEndCommandBuffer(cb);
+
+  // 3. Submit and wait; the staging buffer goes when this returns
+  VkFence done;
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(device_handle_, &fence_info, nullptr, &done));
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cb;
+  VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, done));
+  VK_CHECK(vkWaitForFences(device_handle_, 1, &done, VK_TRUE, UINT64_MAX));
+  vkDestroyFence(device_handle_, done, nullptr);
+  vkDestroyCommandPool(device_handle_, pool, nullptr);
+}
+
+void image_block::destroy() {
+  if (device_handle_ == VK_NULL_HANDLE)
+    return;
+  if (sampler_handle != VK_NULL_HANDLE)
+    vkDestroySampler(device_handle_, sampler_handle, nullptr);
+  if (view_handle != VK_NULL_HANDLE)
+    vkDestroyImageView(device_handle_, view_handle, nullptr);
+  if (image_handle != VK_NULL_HANDLE)
+    vkDestroyImage(device_handle_, image_handle, nullptr);
+  if (memory_handle != VK_NULL_HANDLE)
+    vkFreeMemory(device_handle_, memory_handle, nullptr);
+
+  sampler_handle = VK_NULL_HANDLE;
+  view_handle = VK_NULL_HANDLE;
+  image_handle = VK_NULL_HANDLE;
+  memory_handle = VK_NULL_HANDLE;
+  creation_serial = 0;
+  device_handle_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,71 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+// image_block: the image counterpart of memory_block, for kernels that read
+// through the texture path.
+//
+// One 1D or 2D image (one mip level, one layer) in DEVICE_LOCAL memory with
+// optimal tiling, i.e. in whatever swizzled texel order the GPU prefers,
+// plus a view and a nearest-filter sampler for combined image sampler
+// descriptors. upload() fills it through a staging memory_block and leaves
+// it in SHADER_READ_ONLY_OPTIMAL, the layout the descriptors promise.
+//
+// RAII and move-only, like memory_block.
+class image_block {
+public:
+  VkImage image_handle = VK_NULL_HANDLE;
+  VkDeviceMemory memory_handle = VK_NULL_HANDLE;
+  VkImageView view_handle = VK_NULL_HANDLE;
+  VkSampler sampler_handle = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0, height = 0; // height is 1 for a 1D image
+  // From memory_block::next_creation_serial(), for descriptor caches.
+  uint64_t creation_serial = 0;
+
+  image_block() = default;
+  ~image_block();
+
+  image_block(const image_block &) = delete;
+  image_block &operator=(const image_block &) = delete;
+  image_block(image_block &&other) noexcept;
+  image_block &operator=(image_block &&other) noexcept;
+
+  // type is VK_IMAGE_TYPE_1D (height must be 1) or VK_IMAGE_TYPE_2D.
+  // Throws std::runtime_error when the device cannot sample `format` with
+  // optimal tiling or has no DEVICE_LOCAL type for the image.
+  void create(VkDevice logical_device, VkPhysicalDevice physical_device,
+              VkImageType type, uint32_t width, uint32_t height,
+              VkFormat format);
+
+  // Copies width * height tightly packed texels, row by row, into the image
+  // through a one-off staging buffer and command buffer on `queue`, and
+  // waits for the copy.
+  void upload(VkPhysicalDevice physical_device, VkQueue queue,
+              uint32_t queue_family_index, const void *texels,
+              VkDeviceSize bytes);
+
+  void destroy();
+
+private:
+  VkDevice device_handle_ = VK_NULL_HANDLE;
+  void take(image_block &other);
+};
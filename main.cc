@@ -16,70 +16,679 @@
  * ----------------------------------------------------------------------------
  */
 
+#include "alloc_bench.h"
+#include "app_bench.h"
+#include "coherence_bench.h"
+#include "core_to_core.h"
+#include "cpu_bandwidth.h"
+#include "cpu_latency.h"
 #include "gpu_system.h"
 #include "memory_block.h"
+#include "memory_path.h"
+#include "monitor.h"
+#include "multi_device.h"
+#include "numa_matrix.h"
+#include "overlap_bench.h"
+#include "regression.h"
 #include "shader_pipeline.h"
-#include "timer.h"
+#include "store_bench.h"
+#include "submit_bench.h"
+#include "sweep_cli.h"
+#include "sweep_driver.h"
 #include "utils.h"
+#include <algorithm>
+#include <csignal>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-// Updated to use the safer memory_block API:
-// - rely on RAII: explicit destroy() calls removed (destructors free resources)
-// - map/unmap calls prefer the device stored by memory_block::create(); we
-//   pass VK_NULL_HANDLE for clarity to show the caller no longer needs to
-//   forward the device handle repeatedly.
-int main() {
-  gpu_system m4;
-  m4.initialize();
-
-  shader_pipeline latency_bench;
-  latency_bench.prepare(m4.logical_device_handle, "lat_comp.spv");
-
-  timer stopwatch;
-  stopwatch.create(m4.logical_device_handle, m4.physical_device_handle);
-
-  // The Sweep
-  for (uint32_t count : {16 * 1024, 1024 * 1024, 256 * 1024 * 1024}) {
-    VkDeviceSize size = count * sizeof(uint32_t);
-
-    // memory_block now stores the device internally when create() is called.
-    // We can rely on RAII to free resources when the objects go out of scope.
-    memory_block nodes, result;
-
-    // Setup memory (store device internally during create)
-    nodes.create(m4.logical_device_handle, m4.physical_device_handle, size,
-                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    result.create(m4.logical_device_handle, m4.physical_device_handle, size,
-                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    // Prep data: pass VK_NULL_HANDLE to map() to indicate we rely on the
-    // stored device inside memory_block. The implementation prefers the
-    // stored device and ignores the passed parameter for compatibility.
-    uint32_t *ptr = reinterpret_cast<uint32_t *>(nodes.map(VK_NULL_HANDLE));
-    initialize_and_shuffle_indices(ptr, count);
-    nodes.unmap(VK_NULL_HANDLE);
-
-    // Run
-    latency_bench.bind_blocks(m4.logical_device_handle, {&nodes, &result});
-    latency_bench.run(m4.logical_device_handle, m4.compute_queue_handle,
-                      m4.compute_queue_family_index, stopwatch);
-
-    // Result
-    double ns = stopwatch.get_nanoseconds(m4.logical_device_handle) / 1000000.0;
-    std::cout << formatBytes(size) << " | Latency: " << ns << " ns/hop"
-              << std::endl;
-
-    // No explicit destroy() needed: nodes and result will be destroyed when
-    // they go out of scope, freeing their Vulkan resources in their
-    // destructors.
-  }
-
-  m4.shutdown();
+// Chain lengths (in uint32_t nodes) every latency mode sweeps.
+static const std::vector<uint32_t> sweep_counts = {16 * 1024, 1024 * 1024,
+                                                   256 * 1024 * 1024};
+
+// Set by SIGINT / SIGTERM; "monitor" finishes its sample and exits cleanly.
+static volatile std::sig_atomic_t stop_requested = 0;
+static void request_stop(int) { stop_requested = 1; }
+
+// The CPU chase settings shared by "cpu" and "compare":
+//   [--thp | --hugetlb] [--numa=local|remote|interleave|node:N] [cpu]
+//   page backing, NUMA placement and the core to pin the walker to
+static cpu_latency_engine cpu_engine_from_args(int argc, char **argv,
+                                               int first) {
+  cpu_latency_engine engine;
+  for (int i = first; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--thp")
+      engine.backing = page_backing::transparent_huge;
+    else if (arg == "--hugetlb")
+      engine.backing = page_backing::explicit_huge;
+    else if (arg.rfind("--numa=", 0) == 0)
+      engine.placement = numa_placement::parse(arg.substr(7));
+    else
+      engine.cpu = std::stoi(arg);
+  }
+  engine.create();
+  return engine;
+}
+
+static void print_cpu_header(const cpu_latency_engine &engine) {
+  std::cout << "CPU chase: " << engine.clock().source << " at "
+            << engine.clock().ns_per_tick << " ns/tick, "
+            << page_backing_name(engine.backing_used) << " pages, "
+            << engine.numa_used << ", "
+            << (engine.pinned ? "pinned to cpu " + std::to_string(engine.cpu)
+                              : std::string("unpinned"))
+            << std::endl;
+}
+
+// Usage:
+//   m4_profiler [sweep] [--flags]    latency sweep, first device by default;
+//                                    flags in sweep_cli.h (sizes, layout,
+//                                    engine, memory type, ndjson/csv, ...)
+//   m4_profiler devices [--serial]   the default latency sweep on every
+//                                    device and compute queue family, as one
+//                                    comparative table; other modes measure
+//                                    one device at a time
+//   m4_profiler queues [N] [device]  N chasers on N queues of one device,
+//                                    against a chaser running alone
+//   m4_profiler coherence [rounds]   host <-> GPU flag round trips in every
+//                                    host-visible memory type
+//   m4_profiler cpu [--thp|--hugetlb] [--numa=...] [cpu]
+//                                    the same sweep walked by one pinned core
+//   m4_profiler bandwidth [--thp|--hugetlb] [--numa=...] [avx512|avx2|scalar]
+//                                    host read/write/copy/triad GB/s over
+//                                    the sweep sizes, 1 thread to all cores
+//   m4_profiler c2c [same-line|false-shared|padded] [rounds]
+//                                    core x core cache-line handoff latency
+//                                    (every layout when none is named)
+//   m4_profiler numa [count]         CPU node x memory node ns/hop and GB/s
+//                                    over a count-node chain
+//   m4_profiler regress [--save] [--dir D] [--tolerance T] [--reps N]
+//                       [--device N|name]
+//                                    fixed latency/bandwidth/dispatch set
+//                                    against the device's baseline file;
+//                                    exits 2 when a metric regressed, 1
+//                                    when the set could not be run
+//   m4_profiler app [hash|btree|bfs] [--sizes 64K,1M,...] [--fanout N]
+//                   [--load F] [--reps N]
+//                                    hash probes, B+-tree lookups and R-MAT
+//                                    BFS: ns per lookup and lookups/s per
+//                                    structure size (every kernel by default)
+//   m4_profiler paths [ssbo|ssbo-ro|ubo|utexel|stexel|image1d|image2d|push]
+//                     [--sizes 128,4K,...] [--hops N]
+//                                    the chase through each way of reading a
+//                                    table, one column per path
+//   m4_profiler stores [line bytes] [rounds]
+//                                    store->load chase, partial vs full line
+//                                    store GB/s over the sweep sizes, and
+//                                    cross-workgroup message latency
+//   m4_profiler record [--threads 1,2,4,...] [--buffers N] [--dispatches N]
+//                      [--reps N]
+//                                    dispatches/s recorded and submitted by
+//                                    N threads, through one locked queue and
+//                                    through merged secondaries
+//   m4_profiler alloc [none|host|gpu] [--sizes 64K,1M,...] [--reps N]
+//                     [--threads N] [--device N|name]
+//                                    create/allocate/bind/map/first write/free
+//                                    cost per memory type and size, with the
+//                                    block prefaulted from the host or zeroed
+//                                    by vkCmdFillBuffer (every mode when none
+//                                    is named), against reusing a pooled block
+//   m4_profiler overlap [--copy-mb N] [--hops N] [--reps N] [--device N|name]
+//                                    vkCmdCopyBuffer on a transfer queue beside
+//                                    the chase and the read kernel: copy GB/s
+//                                    and kernel slowdown against each alone
+//   m4_profiler monitor [--interval S] [--duty F] [--textfile P]
+//                       [--socket P] [--device N|name] [--once]
+//                                    keeps a few chase sizes and a read probe
+//                                    loaded and samples them every S seconds
+//                                    (GPU busy at most F of the time) as
+//                                    Prometheus text; --once prints one
+//                                    sample and exits
+//   m4_profiler compare [--thp|--hugetlb] [--numa=...] [cpu]
+//                                    GPU and CPU ns/hop side by side
+int main(int argc, char **argv) {
+  std::string mode = argc > 1 ? argv[1] : "sweep";
+  if (mode.rfind("--", 0) == 0)
+    mode = "sweep";
+
+  if (mode == "sweep") {
+    sweep_options options;
+    for (uint32_t count : sweep_counts)
+      options.sizes.push_back((uint64_t)count * sizeof(uint32_t));
+    try {
+      parse_sweep_options(argc, argv, argc > 1 && argv[1][0] != '-' ? 2 : 1,
+                          options);
+      return run_sweep(options, std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  if (mode == "devices") {
+    bool parallel = !(argc > 2 && std::string(argv[2]) == "--serial");
+    print_device_report(run_all_devices(sweep_counts, "lat_comp.spv", parallel),
+                        std::cout);
+    return 0;
+  }
+
+  if (mode == "queues") {
+    try {
+      uint32_t queues = argc > 2 ? (uint32_t)std::stoul(argv[2]) : 2;
+      uint32_t device = argc > 3 ? (uint32_t)std::stoul(argv[3]) : 0;
+      print_queue_interference(
+          run_queue_interference(device, queues, sweep_counts, "lat_comp.spv"),
+          std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "coherence") {
+    try {
+      uint32_t rounds = argc > 2 ? (uint32_t)std::stoul(argv[2]) : 10000;
+      gpu_system m4;
+      m4.initialize();
+      print_coherence_report(
+          run_coherence_pingpong(m4, "coherence_pingpong.spv", rounds),
+          std::cout);
+      m4.shutdown();
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "cpu") {
+    try {
+      cpu_latency_engine engine = cpu_engine_from_args(argc, argv, 2);
+      engine.run(sweep_counts, [](const sweep_point &point) {
+        std::cout << formatBytes(point.bytes) << " | Latency: "
+                  << point.ns_per_hop << " ns/hop" << std::endl;
+      });
+      print_cpu_header(engine);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "bandwidth") {
+    try {
+      cpu_bandwidth_engine engine;
+      for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--thp")
+          engine.backing = page_backing::transparent_huge;
+        else if (arg == "--hugetlb")
+          engine.backing = page_backing::explicit_huge;
+        else if (arg.rfind("--numa=", 0) == 0)
+          engine.placement = numa_placement::parse(arg.substr(7));
+        else
+          engine.isa = arg;
+      }
+      engine.create();
+      std::cout << "CPU bandwidth: " << engine.isa_used << " kernels, "
+                << engine.thread_counts().back() << " cpus" << std::endl;
+
+      std::vector<uint64_t> sizes;
+      for (uint32_t count : sweep_counts)
+        sizes.push_back((uint64_t)count * sizeof(uint32_t));
+      engine.run(sizes, [](const bandwidth_point &point) {
+        std::cout << formatBytes(point.bytes) << " | "
+                  << bandwidth_kernel_name(point.kernel)
+                  << (point.non_temporal ? " (nt)" : "") << " | "
+                  << point.threads << " threads | Bandwidth: " << point.gb_per_s
+                  << " GB/s" << std::endl;
+      });
+      std::cout << "NUMA: " << engine.numa_used << std::endl;
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "regress") {
+    regression_options opts;
+    std::string dir = "baselines", device = "0";
+    bool save = false;
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--save") {
+          save = true;
+          continue;
+        }
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--dir")
+          dir = value;
+        else if (flag == "--tolerance")
+          opts.tolerance = std::stod(value);
+        else if (flag == "--reps")
+          opts.repetitions = (uint32_t)std::stoul(value);
+        else if (flag == "--device")
+          device = value;
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    try {
+      gpu_system gpu;
+      gpu.initialize(gpu_system::find_device(device));
+      std::string path = baseline_path(dir, gpu);
+      std::vector<metric_result> current = run_regression_set(gpu, opts);
+      gpu.shutdown();
+
+      std::vector<metric_result> baseline;
+      if (save || !load_baseline(path, baseline)) {
+        save_baseline(path, gpu, current);
+        std::cout << "Baseline written to " << path << std::endl;
+        compare_to_baseline({}, current, opts.tolerance, std::cout);
+        return 0;
+      }
+      std::cout << "Comparing against " << path << " (tolerance "
+                << opts.tolerance * 100.0 << "%)" << std::endl;
+      uint32_t regressed =
+          compare_to_baseline(baseline, current, opts.tolerance, std::cout);
+      if (regressed > 0) {
+        std::cout << regressed << " metric(s) regressed" << std::endl;
+        return 2;
+      }
+      return 0;
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  if (mode == "app") {
+    app_bench bench;
+    std::vector<uint64_t> sizes = {64 * 1024, 1024 * 1024, 16 * 1024 * 1024,
+                                   256 * 1024 * 1024};
+    try {
+      std::vector<app_kernel> named;
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag.rfind("--", 0) != 0) {
+          named.push_back(parse_app_kernel(flag));
+          continue;
+        }
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--sizes")
+          sizes = parse_byte_sizes(value);
+        else if (flag == "--fanout")
+          bench.fanout = (uint32_t)std::stoul(value);
+        else if (flag == "--load")
+          bench.load_factor = std::stod(value);
+        else if (flag == "--reps")
+          bench.repetitions = (uint32_t)std::stoul(value);
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+      if (!named.empty())
+        bench.kernels = named;
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    gpu_system m4;
+    m4.initialize();
+    bench.run(m4, sizes,
+              [](const app_point &point) { print_app_point(point, std::cout); });
+    m4.shutdown();
+    return 0;
+  }
+
+  if (mode == "paths") {
+    std::vector<memory_path> paths;
+    std::vector<uint64_t> sizes = {
+        128,        4 * 1024,    16 * 1024,        64 * 1024,
+        256 * 1024, 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024};
+    uint32_t hops = 1000000;
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag.rfind("--", 0) != 0) {
+          paths.push_back(parse_memory_path(flag));
+          continue;
+        }
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--sizes")
+          sizes = parse_byte_sizes(value);
+        else if (flag == "--hops")
+          hops = (uint32_t)std::stoul(value);
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    if (paths.empty())
+      paths = all_memory_paths();
+    std::vector<uint32_t> counts;
+    for (uint64_t bytes : sizes)
+      counts.push_back((uint32_t)(bytes / sizeof(uint32_t)));
+
+    gpu_system m4;
+    m4.initialize();
+    print_memory_path_report(run_memory_paths(m4, paths, counts, hops),
+                             std::cout);
+    m4.shutdown();
+    return 0;
+  }
+
+  if (mode == "stores") {
+    try {
+      uint32_t line_bytes = argc > 2 ? (uint32_t)std::stoul(argv[2]) : 128;
+      uint32_t rounds = argc > 3 ? (uint32_t)std::stoul(argv[3]) : 10000;
+      std::vector<uint64_t> sizes;
+      for (uint32_t count : sweep_counts)
+        sizes.push_back((uint64_t)count * sizeof(uint32_t));
+
+      gpu_system m4;
+      m4.initialize();
+      std::vector<store_load_point> chains =
+          run_store_load_chains(m4, sweep_counts);
+      std::vector<store_rate_point> rates =
+          run_store_throughput(m4, sizes, line_bytes);
+      visibility_result visibility = run_visibility_pingpong(m4, rounds);
+      m4.shutdown();
+      print_store_report(chains, rates, visibility, std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "record") {
+    recording_options opts;
+    opts.thread_counts.clear();
+    for (uint32_t n = 1; n <= std::max(1u, std::thread::hardware_concurrency());
+         n *= 2)
+      opts.thread_counts.push_back(n);
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--threads") {
+          opts.thread_counts.clear();
+          std::stringstream list(value);
+          for (std::string item; std::getline(list, item, ',');)
+            opts.thread_counts.push_back((uint32_t)std::stoul(item));
+        } else if (flag == "--buffers") {
+          opts.buffers_per_thread = (uint32_t)std::stoul(value);
+        } else if (flag == "--dispatches") {
+          opts.dispatches_per_buffer = (uint32_t)std::stoul(value);
+        } else if (flag == "--reps") {
+          opts.repetitions = (uint32_t)std::stoul(value);
+        } else {
+          throw std::invalid_argument("unknown option: " + flag);
+        }
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    gpu_system m4;
+    m4.initialize();
+    print_recording_report(run_recording_scaling(m4, opts), std::cout);
+    m4.shutdown();
+    return 0;
+  }
+
+  if (mode == "alloc") {
+    allocation_options opts;
+    std::vector<prefault_mode> named;
+    std::string device = "0";
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag.rfind("--", 0) != 0) {
+          named.push_back(parse_prefault_mode(flag));
+          continue;
+        }
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--sizes")
+          opts.sizes = parse_byte_sizes(value);
+        else if (flag == "--reps")
+          opts.repetitions = (uint32_t)std::stoul(value);
+        else if (flag == "--threads")
+          opts.touch_threads = (uint32_t)std::stoul(value);
+        else if (flag == "--device")
+          device = value;
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+      if (!named.empty())
+        opts.prefaults = named;
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    gpu_system gpu;
+    try {
+      gpu.initialize(gpu_system::find_device(device));
+      print_allocation_report(run_allocation_sweep(gpu, opts), std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << "alloc: " << e.what() << std::endl;
+      gpu.shutdown();
+      return 1;
+    }
+    gpu.shutdown();
+    return 0;
+  }
+
+  if (mode == "overlap") {
+    overlap_options opts;
+    std::string device = "0";
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--copy-mb")
+          opts.copy_buffer_bytes = std::stoull(value) * 1024 * 1024;
+        else if (flag == "--hops")
+          opts.hops = (uint32_t)std::stoul(value);
+        else if (flag == "--reps")
+          opts.repetitions = (uint32_t)std::stoul(value);
+        else if (flag == "--device")
+          device = value;
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    gpu_system gpu;
+    try {
+      gpu.initialize(gpu_system::find_device(device));
+      print_overlap_report(gpu, run_overlap(gpu, opts), std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << "overlap: " << e.what() << std::endl;
+      gpu.shutdown();
+      return 1;
+    }
+    gpu.shutdown();
+    return 0;
+  }
+
+  if (mode == "monitor") {
+    latency_monitor monitor;
+    std::string device = "0";
+    bool once = false;
+    try {
+      for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--once") {
+          once = true;
+          continue;
+        }
+        if (i + 1 >= argc)
+          throw std::invalid_argument("missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--interval")
+          monitor.interval_seconds = std::stod(value);
+        else if (flag == "--duty")
+          monitor.max_duty_cycle = std::stod(value);
+        else if (flag == "--textfile")
+          monitor.textfile_path = value;
+        else if (flag == "--socket")
+          monitor.socket_path = value;
+        else if (flag == "--device")
+          device = value;
+        else
+          throw std::invalid_argument("unknown option: " + flag);
+      }
+      if (!once && monitor.textfile_path.empty() &&
+          monitor.socket_path.empty())
+        throw std::invalid_argument(
+            "monitor needs --textfile, --socket or --once");
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
+    gpu_system gpu;
+    try {
+      gpu.initialize(gpu_system::find_device(device));
+      monitor.create(gpu);
+      if (once) {
+        std::cout << latency_monitor::exposition(monitor.sample());
+      } else {
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+        monitor.run(stop_requested);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "monitor: " << e.what() << std::endl;
+      monitor.destroy();
+      gpu.shutdown();
+      return 1;
+    }
+    monitor.destroy();
+    gpu.shutdown();
+    return 0;
+  }
+
+  if (mode == "numa") {
+    try {
+      uint32_t count = argc > 2 ? (uint32_t)std::stoul(argv[2])
+                                : sweep_counts.back();
+      print_numa_matrix(run_numa_matrix(count), std::cout);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode == "c2c") {
+    try {
+      std::vector<line_layout> layouts = {line_layout::same_line,
+                                          line_layout::false_shared,
+                                          line_layout::padded};
+      uint32_t rounds = 1000;
+      for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool named = false;
+        for (line_layout layout : {line_layout::same_line,
+                                   line_layout::false_shared,
+                                   line_layout::padded})
+          if (arg == line_layout_name(layout)) {
+            layouts = {layout};
+            named = true;
+          }
+        if (!named)
+          rounds = (uint32_t)std::stoul(arg);
+      }
+      for (line_layout layout : layouts) {
+        core_to_core_matrix matrix = run_core_to_core(layout, rounds);
+        print_core_to_core(matrix, true, std::cout);
+        print_core_to_core(matrix, false, std::cout);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (mode != "compare") {
+    std::cerr << "Unknown mode: " << mode << std::endl;
+    return 1;
+  }
+
+  try {
+    // compare: buffer setup, shuffling and timing for each size live in
+    // sweep_driver; memory_blocks there are still freed by RAII / release().
+    // The CPU settings are parsed first so a typo fails before the GPU sweep.
+    cpu_latency_engine engine = cpu_engine_from_args(argc, argv, 2);
+    gpu_system m4;
+    m4.initialize();
+
+    shader_pipeline latency_bench;
+    latency_bench.prepare(m4.logical_device_handle, "lat_comp.spv",
+                          m4.push_descriptor_supported);
+
+    // The Sweep: the driver shuffles the next size on a worker thread while
+    // the GPU measures the current one, and reports each point as it lands.
+    // The GPU rows are held back until the CPU has walked the same chains
+    // (same seed), then both are printed on one line per size.
+    uint64_t seed = random_seed();
+    sweep_driver sweep;
+    sweep.seed = seed;
+    sweep.create(m4, latency_bench);
+    std::vector<sweep_point> gpu_points;
+    sweep.run(sweep_counts,
+              [&](const sweep_point &point) { gpu_points.push_back(point); });
+    sweep.destroy();
+
+    latency_bench.destroy(m4.logical_device_handle);
+    m4.shutdown();
+
+    engine.seed = seed;
+    size_t row = 0;
+    engine.run(sweep_counts, [&](const sweep_point &point) {
+      std::cout << formatBytes(point.bytes) << " | GPU Latency: "
+                << gpu_points[row++].ns_per_hop << " ns/hop | CPU Latency: "
+                << point.ns_per_hop << " ns/hop" << std::endl;
+    });
+    print_cpu_header(engine);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
   return 0;
-}
\ No newline at end of file
+}
@@ -18,8 +18,28 @@
 
 #include "memory_block.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <stdexcept>
 
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double nanoseconds_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+}
+
+} // namespace
+
+uint64_t memory_block::next_creation_serial()
+{
+  static std::atomic<uint64_t> next_serial{1};
+  return next_serial++;
+}
+
 memory_block::~memory_block()
 {
   destroy(device_handle_);
@@ -31,6 +51,10 @@ memory_block::memory_block(memory_block &&other) noexcept
   logical_memory_block_handle = other.logical_memory_block_handle;
   physical_memory_block_handle = other.physical_memory_block_handle;
   device_size = other.device_size;
+  creation_serial = other.creation_serial;
+  memory_type_index = other.memory_type_index;
+  memory_type_flags = other.memory_type_flags;
+  timings = other.timings;
 
   device_handle_ = other.device_handle_;
   allocation_size_ = other.allocation_size_;
@@ -41,6 +65,9 @@ memory_block::memory_block(memory_block &&other) noexcept
   other.logical_memory_block_handle = VK_NULL_HANDLE;
   other.physical_memory_block_handle = VK_NULL_HANDLE;
   other.device_size = 0;
+  other.creation_serial = 0;
+  other.memory_type_index = 0;
+  other.memory_type_flags = 0;
   other.device_handle_ = VK_NULL_HANDLE;
   other.allocation_size_ = 0;
   other.owns_buffer_ = false;
@@ -56,6 +83,10 @@ memory_block &memory_block::operator=(memory_block &&other) noexcept
     logical_memory_block_handle = other.logical_memory_block_handle;
     physical_memory_block_handle = other.physical_memory_block_handle;
     device_size = other.device_size;
+    creation_serial = other.creation_serial;
+    memory_type_index = other.memory_type_index;
+    memory_type_flags = other.memory_type_flags;
+    timings = other.timings;
 
     device_handle_ = other.device_handle_;
     allocation_size_ = other.allocation_size_;
@@ -66,6 +97,9 @@ memory_block &memory_block::operator=(memory_block &&other) noexcept
     other.logical_memory_block_handle = VK_NULL_HANDLE;
     other.physical_memory_block_handle = VK_NULL_HANDLE;
     other.device_size = 0;
+    other.creation_serial = 0;
+    other.memory_type_index = 0;
+    other.memory_type_flags = 0;
     other.device_handle_ = VK_NULL_HANDLE;
     other.allocation_size_ = 0;
     other.owns_buffer_ = false;
@@ -78,13 +112,18 @@ memory_block &memory_block::operator=(memory_block &&other) noexcept
 void memory_block::create(VkDevice logical_device,
                           VkPhysicalDevice physical_device, VkDeviceSize size,
                           VkBufferUsageFlags buffer_usage_flags,
-                          VkMemoryPropertyFlags memory_property_flags)
+                          VkMemoryPropertyFlags memory_property_flags,
+                          uint32_t required_memory_type)
 {
   // store the requested logical size (what callers expect) and the device to
   // be used by subsequent operations.
   device_size = size;
   device_handle_ = logical_device;
 
+  creation_serial = next_creation_serial();
+  timings = memory_block_timings{};
+
+  clock_type::time_point start = clock_type::now();
   VkBufferCreateInfo buffer_info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
   buffer_info.size = device_size;
   buffer_info.usage = buffer_usage_flags;
@@ -97,14 +136,31 @@ void memory_block::create(VkDevice logical_device,
 
   VkMemoryRequirements memory_requirements;
   vkGetBufferMemoryRequirements(device_handle_, logical_memory_block_handle, &memory_requirements);
+  timings.create_buffer_ns = nanoseconds_since(start);
 
   VkMemoryAllocateInfo alloc_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
   alloc_info.allocationSize = memory_requirements.size;
-  alloc_info.memoryTypeIndex = find_memory_type(physical_device, memory_requirements.memoryTypeBits, memory_property_flags);
+  try {
+    alloc_info.memoryTypeIndex = find_memory_type(physical_device, memory_requirements.memoryTypeBits,
+                                                  memory_property_flags, required_memory_type);
+  } catch (...) {
+    vkDestroyBuffer(device_handle_, logical_memory_block_handle, nullptr);
+    logical_memory_block_handle = VK_NULL_HANDLE;
+    owns_buffer_ = false;
+    throw;
+  }
+
+  VkPhysicalDeviceMemoryProperties mem_properties;
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+  memory_type_index = alloc_info.memoryTypeIndex;
+  memory_type_flags = mem_properties.memoryTypes[memory_type_index].propertyFlags;
 
   allocation_size_ = alloc_info.allocationSize;
 
-  if (vkAllocateMemory(device_handle_, &alloc_info, nullptr, &physical_memory_block_handle) != VK_SUCCESS) {
+  start = clock_type::now();
+  VkResult allocated = vkAllocateMemory(device_handle_, &alloc_info, nullptr, &physical_memory_block_handle);
+  timings.allocate_ns = nanoseconds_since(start);
+  if (allocated != VK_SUCCESS) {
     // cleanup previously created buffer
     if (owns_buffer_) {
       vkDestroyBuffer(device_handle_, logical_memory_block_handle, nullptr);
@@ -115,7 +171,10 @@ void memory_block::create(VkDevice logical_device,
   }
   owns_memory_ = true;
 
-  if (vkBindBufferMemory(device_handle_, logical_memory_block_handle, physical_memory_block_handle, 0) != VK_SUCCESS) {
+  start = clock_type::now();
+  VkResult bound = vkBindBufferMemory(device_handle_, logical_memory_block_handle, physical_memory_block_handle, 0);
+  timings.bind_ns = nanoseconds_since(start);
+  if (bound != VK_SUCCESS) {
     // cleanup on failure to bind
     if (owns_memory_) {
       vkFreeMemory(device_handle_, physical_memory_block_handle, nullptr);
@@ -143,7 +202,9 @@ void *memory_block::map(VkDevice /*logical_device*/)
 
   void *data = nullptr;
   VkDeviceSize map_size = allocation_size_ == 0 ? device_size : allocation_size_;
+  clock_type::time_point start = clock_type::now();
   VkResult res = vkMapMemory(device_handle_, physical_memory_block_handle, 0, map_size, 0, &data);
+  timings.map_ns = nanoseconds_since(start);
   if (res != VK_SUCCESS) {
     throw std::runtime_error("vkMapMemory failed for memory_block");
   }
@@ -155,7 +216,9 @@ void memory_block::unmap(VkDevice /*logical_device*/)
   if (device_handle_ == VK_NULL_HANDLE || physical_memory_block_handle == VK_NULL_HANDLE) {
     return;
   }
+  clock_type::time_point start = clock_type::now();
   vkUnmapMemory(device_handle_, physical_memory_block_handle);
+  timings.unmap_ns = nanoseconds_since(start);
 }
 
 void memory_block::destroy(VkDevice /*logical_device*/)
@@ -167,6 +230,7 @@ void memory_block::destroy(VkDevice /*logical_device*/)
     return;
   }
 
+  clock_type::time_point start = clock_type::now();
   if (logical_memory_block_handle != VK_NULL_HANDLE && owns_buffer_) {
     vkDestroyBuffer(dev, logical_memory_block_handle, nullptr);
     logical_memory_block_handle = VK_NULL_HANDLE;
@@ -178,16 +242,21 @@ void memory_block::destroy(VkDevice /*logical_device*/)
     physical_memory_block_handle = VK_NULL_HANDLE;
     owns_memory_ = false;
   }
+  timings.free_ns = nanoseconds_since(start);
 
-  // Reset stored device and sizes
+  // Reset stored device and sizes (timings stay readable)
   device_handle_ = VK_NULL_HANDLE;
   device_size = 0;
   allocation_size_ = 0;
+  creation_serial = 0;
+  memory_type_index = 0;
+  memory_type_flags = 0;
 }
 
 uint32_t memory_block::find_memory_type(VkPhysicalDevice physical_device,
                                        uint32_t type_filter,
-                                       VkMemoryPropertyFlags memory_property_flags)
+                                       VkMemoryPropertyFlags memory_property_flags,
+                                       uint32_t required_memory_type)
 {
   VkPhysicalDeviceMemoryProperties mem_properties;
   vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
@@ -196,7 +265,9 @@ uint32_t memory_block::find_memory_type(VkPhysicalDevice physical_device,
     bool is_type_allowed = (type_filter & (1 << i)) != 0;
     bool has_required_properties = (mem_properties.memoryTypes[i].propertyFlags & memory_property_flags) == memory_property_flags;
 
-    if (is_type_allowed && has_required_properties) {
+    bool is_type_requested = required_memory_type == any_memory_type || required_memory_type == i;
+
+    if (is_type_allowed && has_required_properties && is_type_requested) {
       return i;
     }
   }
@@ -219,6 +290,16 @@ void memory_block::sync_to_gpu(VkDevice /*logical_device*/)
   vkFlushMappedMemoryRanges(device_handle_, 1, &range);
 }
 
+void memory_block::write(const void *data, VkDeviceSize bytes)
+{
+  // One sequential copy, so write-combined mappings are fine too
+  std::memcpy(map(device_handle_), data, bytes);
+  if (!(memory_type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+    sync_to_gpu(device_handle_);
+  }
+  unmap(device_handle_);
+}
+
 void memory_block::sync_from_gpu(VkDevice /*logical_device*/)
 {
   // Invalidate host cache to see device writes
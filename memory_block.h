@@ -21,6 +21,18 @@
 #include <vulkan/vulkan.h>
 #include <cstdint>
 
+// Wall time of each Vulkan call behind a memory_block, in nanoseconds. A
+// call refreshes its own entry (map_ns is the latest map()); destroy() keeps
+// them, so a caller can read a block's whole lifetime after freeing it.
+struct memory_block_timings {
+  double create_buffer_ns = 0.0; // vkCreateBuffer + memory requirements
+  double allocate_ns = 0.0;      // vkAllocateMemory
+  double bind_ns = 0.0;          // vkBindBufferMemory
+  double map_ns = 0.0;           // vkMapMemory
+  double unmap_ns = 0.0;         // vkUnmapMemory
+  double free_ns = 0.0;          // vkDestroyBuffer + vkFreeMemory
+};
+
 // memory_block: a minimal, entry-level Vulkan buffer+memory helper.
 //
 // This class is intended to be an approachable entry point for developers who
@@ -70,6 +82,21 @@ public:
   // Logical size requested by the caller (kept for compatibility).
   VkDeviceSize device_size = 0;
 
+  // Process-unique number stamped by create(). Caches keyed on handles use it
+  // to tell a recycled VkBuffer value apart from the buffer it used to name.
+  uint64_t creation_serial = 0;
+  // Hands out those numbers; image_block draws from the same counter so a
+  // serial names one resource of either kind.
+  static uint64_t next_creation_serial();
+
+  // Memory type create() settled on, and everything that type offers (may be
+  // more than was asked for, e.g. HOST_CACHED on unified memory).
+  uint32_t memory_type_index = 0;
+  VkMemoryPropertyFlags memory_type_flags = 0;
+
+  // Cost of the calls so far; see memory_block_timings.
+  memory_block_timings timings;
+
   // Construction / destruction
   memory_block() = default;
   ~memory_block();
@@ -80,12 +107,19 @@ public:
   memory_block(memory_block &&other) noexcept;
   memory_block &operator=(memory_block &&other) noexcept;
 
+  // Marker for create(): take the first memory type with the flags asked for
+  static constexpr uint32_t any_memory_type = ~0u;
+
   // Create a buffer + allocate memory. Kept signature to minimize changes.
+  // Pass required_memory_type to pin the allocation to one specific memory
+  // type index (it must still have memory_property_flags); create() throws
+  // if the buffer cannot live there.
   void create(VkDevice logical_device,
               VkPhysicalDevice physical_device,
               VkDeviceSize size,
               VkBufferUsageFlags usage,
-              VkMemoryPropertyFlags memory_property_flags);
+              VkMemoryPropertyFlags memory_property_flags,
+              uint32_t required_memory_type = any_memory_type);
 
   // Map / unmap for host access. Device param is accepted for compatibility.
   void *map(VkDevice logical_device);
@@ -98,6 +132,10 @@ public:
   void sync_to_gpu(VkDevice logical_device);
   void sync_from_gpu(VkDevice logical_device);
 
+  // Copies `bytes` from `data` to the start of a host-visible block: map,
+  // copy, flush if the type is not coherent, unmap.
+  void write(const void *data, VkDeviceSize bytes);
+
 private:
   // Internal state uses snake_case to avoid confusion with Vulkan names.
   VkDevice device_handle_ = VK_NULL_HANDLE;     // device used to create handles
@@ -108,5 +146,6 @@ private:
   // Helper to pick a memory type index that satisfies the requested properties.
   uint32_t find_memory_type(VkPhysicalDevice physical_device,
                             uint32_t type_filter,
-                            VkMemoryPropertyFlags memory_property_flags);
+                            VkMemoryPropertyFlags memory_property_flags,
+                            uint32_t required_memory_type);
 };
\ No newline at end of file
@@ -0,0 +1,348 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "memory_path.h"
+#include "image_block.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const memory_path every_path[] = {
+    memory_path::storage,       memory_path::storage_readonly,
+    memory_path::uniform,       memory_path::uniform_texel,
+    memory_path::storage_texel, memory_path::image_1d,
+    memory_path::image_2d,      memory_path::push_constant};
+
+// Nodes chase_push.comp declares (128 bytes, the guaranteed minimum).
+constexpr uint32_t push_nodes = 32;
+
+const char *shader_of(memory_path path) {
+  switch (path) {
+  case memory_path::storage_readonly:
+    return "chase_ssbo_ro.spv";
+  case memory_path::uniform:
+    return "chase_ubo.spv";
+  case memory_path::uniform_texel:
+    return "chase_utexel.spv";
+  case memory_path::storage_texel:
+    return "chase_stexel.spv";
+  case memory_path::image_1d:
+    return "chase_image1d.spv";
+  case memory_path::image_2d:
+    return "chase_image2d.spv";
+  case memory_path::push_constant:
+    return "chase_push.spv";
+  default:
+    return "lat_comp.spv";
+  }
+}
+
+// Interleaves the bits of x and y (x in the even bits): the Morton index of
+// (x, y). chase_image2d.comp undoes it with compact_bits().
+uint32_t spread_bits(uint32_t v) {
+  v &= 0x0000FFFFu;
+  v = (v | (v << 8)) & 0x00FF00FFu;
+  v = (v | (v << 4)) & 0x0F0F0F0Fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+// Smallest power-of-two side of a square image holding `count` texels.
+uint32_t square_side(uint32_t count) {
+  uint32_t side = 1;
+  while ((uint64_t)side * side < count)
+    side *= 2;
+  return side;
+}
+
+// A buffer holding `chain`, padded with zeros to `bytes`.
+void upload_chain(gpu_system &gpu, memory_block &block,
+                  const std::vector<uint32_t> &chain, VkDeviceSize bytes,
+                  VkBufferUsageFlags usage) {
+  block.create(gpu.logical_device_handle, gpu.physical_device_handle, bytes,
+               usage,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::vector<uint32_t> padded(bytes / sizeof(uint32_t), 0);
+  std::copy(chain.begin(), chain.end(), padded.begin());
+  block.write(padded.data(), bytes);
+}
+
+// A R32_UINT view of `block` for a texel buffer descriptor; throws when the
+// format cannot be used that way.
+VkBufferView make_texel_view(gpu_system &gpu, memory_block &block,
+                             VkFormatFeatureFlags feature) {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(gpu.physical_device_handle,
+                                      VK_FORMAT_R32_UINT, &properties);
+  if (!(properties.bufferFeatures & feature))
+    throw std::runtime_error("R32_UINT texel buffers not supported");
+  VkBufferViewCreateInfo view_info{VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO};
+  view_info.buffer = block.logical_memory_block_handle;
+  view_info.format = VK_FORMAT_R32_UINT;
+  view_info.offset = 0;
+  view_info.range = VK_WHOLE_SIZE;
+  VkBufferView view;
+  VK_CHECK(vkCreateBufferView(gpu.logical_device_handle, &view_info, nullptr,
+                              &view));
+  return view;
+}
+
+// One size through one path: set up the path's resource, chase, tear down.
+double chase_once(gpu_system &gpu, memory_path path,
+                  const std::vector<uint32_t> &chain, uint32_t hops,
+                  uint32_t repetitions, memory_block &result,
+                  timer &stopwatch) {
+  VkDevice dev = gpu.logical_device_handle;
+  uint32_t count = (uint32_t)chain.size();
+  VkDeviceSize bytes = VkDeviceSize(count) * sizeof(uint32_t);
+
+  shader_pipeline pipeline;
+  pipeline.specialization_constants = {hops};
+  memory_block nodes;
+  image_block image;
+  VkBufferView texel_view = VK_NULL_HANDLE;
+  std::vector<descriptor_resource> resources;
+
+  // 1. The chain, in the form this path reads it
+  switch (path) {
+  case memory_path::storage:
+  case memory_path::storage_readonly:
+    upload_chain(gpu, nodes, chain, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    resources = {&nodes, &result};
+    break;
+  case memory_path::uniform: {
+    // Four nodes a uvec4
+    uint32_t vec4s = (count + 3) / 4;
+    pipeline.specialization_constants.push_back(vec4s);
+    upload_chain(gpu, nodes, chain, VkDeviceSize(vec4s) * 16,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    resources = {&nodes, &result};
+    break;
+  }
+  case memory_path::uniform_texel:
+  case memory_path::storage_texel: {
+    bool uniform = path == memory_path::uniform_texel;
+    upload_chain(gpu, nodes, chain, bytes,
+                 uniform ? VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT
+                         : VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT);
+    texel_view = make_texel_view(
+        gpu, nodes,
+        uniform ? VK_FORMAT_FEATURE_UNIFORM_TEXEL_BUFFER_BIT
+                : VK_FORMAT_FEATURE_STORAGE_TEXEL_BUFFER_BIT);
+    resources = {descriptor_resource(&nodes, texel_view), &result};
+    break;
+  }
+  case memory_path::image_1d:
+    image.create(dev, gpu.physical_device_handle, VK_IMAGE_TYPE_1D, count, 1,
+                 VK_FORMAT_R32_UINT);
+    image.upload(gpu.physical_device_handle, gpu.compute_queue_handle,
+                 gpu.compute_queue_family_index, chain.data(), bytes);
+    resources = {&image, &result};
+    break;
+  case memory_path::image_2d: {
+    uint32_t side = square_side(count);
+    std::vector<uint32_t> texels((size_t)side * side, 0);
+    for (uint32_t y = 0; y < side; y++)
+      for (uint32_t x = 0; x < side; x++) {
+        uint32_t node = spread_bits(x) | (spread_bits(y) << 1);
+        if (node < count)
+          texels[(size_t)y * side + x] = chain[node];
+      }
+    image.create(dev, gpu.physical_device_handle, VK_IMAGE_TYPE_2D, side, side,
+                 VK_FORMAT_R32_UINT);
+    image.upload(gpu.physical_device_handle, gpu.compute_queue_handle,
+                 gpu.compute_queue_family_index, texels.data(),
+                 texels.size() * sizeof(uint32_t));
+    resources = {&image, &result};
+    break;
+  }
+  case memory_path::push_constant:
+    resources = {&result};
+    break;
+  }
+
+  // 2. The kernel; push constants are recorded with every dispatch
+  pipeline.prepare(dev, shader_of(path), gpu.push_descriptor_supported);
+  if (path == memory_path::push_constant) {
+    std::vector<uint32_t> words(push_nodes, 0);
+    std::copy(chain.begin(), chain.end(), words.begin());
+    pipeline.push_constants.resize(pipeline.push_constant_size);
+    std::memcpy(pipeline.push_constants.data(), words.data(),
+                std::min<size_t>(pipeline.push_constant_size,
+                                 words.size() * sizeof(uint32_t)));
+  }
+  pipeline.bind_resources(dev, resources);
+
+  // 3. Median of the timed dispatches after a warm-up
+  double ns = pipeline.median_run_ns(dev, gpu.compute_queue_handle,
+                                     gpu.compute_queue_family_index,
+                                     stopwatch, repetitions);
+
+  pipeline.destroy(dev);
+  if (texel_view != VK_NULL_HANDLE)
+    vkDestroyBufferView(dev, texel_view, nullptr);
+  return ns / hops;
+}
+
+} // namespace
+
+const char *memory_path_name(memory_path path) {
+  switch (path) {
+  case memory_path::storage_readonly:
+    return "ssbo-ro";
+  case memory_path::uniform:
+    return "ubo";
+  case memory_path::uniform_texel:
+    return "utexel";
+  case memory_path::storage_texel:
+    return "stexel";
+  case memory_path::image_1d:
+    return "image1d";
+  case memory_path::image_2d:
+    return "image2d";
+  case memory_path::push_constant:
+    return "push";
+  default:
+    return "ssbo";
+  }
+}
+
+memory_path parse_memory_path(const std::string &name) {
+  for (memory_path path : every_path)
+    if (name == memory_path_name(path))
+      return path;
+  throw std::invalid_argument("unknown memory path: " + name);
+}
+
+std::vector<memory_path> all_memory_paths() {
+  return std::vector<memory_path>(std::begin(every_path), std::end(every_path));
+}
+
+uint64_t memory_path_capacity(const gpu_system &gpu, memory_path path) {
+  const VkPhysicalDeviceLimits &limits = gpu.device_properties.limits;
+  switch (path) {
+  case memory_path::uniform:
+    return (uint64_t)limits.maxUniformBufferRange / 16 * 4;
+  case memory_path::uniform_texel:
+  case memory_path::storage_texel:
+    return limits.maxTexelBufferElements;
+  case memory_path::image_1d:
+    return limits.maxImageDimension1D;
+  case memory_path::image_2d:
+    return (uint64_t)limits.maxImageDimension2D * limits.maxImageDimension2D;
+  case memory_path::push_constant:
+    return std::min<uint64_t>(push_nodes,
+                              limits.maxPushConstantsSize / sizeof(uint32_t));
+  default:
+    return limits.maxStorageBufferRange / sizeof(uint32_t);
+  }
+}
+
+std::vector<path_run> run_memory_paths(gpu_system &gpu,
+                                       const std::vector<memory_path> &paths,
+                                       const std::vector<uint32_t> &counts,
+                                       uint32_t hops, uint32_t repetitions,
+                                       uint64_t seed) {
+  VkDevice dev = gpu.logical_device_handle;
+  memory_block result;
+  result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+
+  std::vector<path_run> runs;
+  for (memory_path path : paths) {
+    path_run run;
+    run.path = path;
+    uint64_t capacity = memory_path_capacity(gpu, path);
+    try {
+      for (uint32_t count : counts) {
+        if (count == 0 || count > capacity)
+          continue;
+        std::vector<uint32_t> chain(count);
+        build_chain(chain.data(), count, chain_layout::random, seed + count);
+
+        sweep_point point;
+        point.count = count;
+        point.bytes = VkDeviceSize(count) * sizeof(uint32_t);
+        point.ns_per_hop = chase_once(gpu, path, chain, hops, repetitions,
+                                      result, stopwatch);
+        run.points.push_back(point);
+      }
+    } catch (const std::exception &e) {
+      run.error = e.what();
+    }
+    runs.push_back(run);
+  }
+
+  stopwatch.destroy(dev);
+  return runs;
+}
+
+void print_memory_path_report(const std::vector<path_run> &runs,
+                              std::ostream &out) {
+  const int first_width = 12, width = 14;
+
+  // 1. Every size any path measured, ascending
+  std::map<uint32_t, VkDeviceSize> sizes;
+  for (const path_run &run : runs)
+    for (const sweep_point &point : run.points)
+      sizes[point.count] = point.bytes;
+
+  out << std::left << std::setw(first_width) << "Size";
+  for (const path_run &run : runs)
+    out << " | " << std::setw(width) << memory_path_name(run.path);
+  out << "\n";
+
+  // 2. A row per size; paths that could not hold it show "-"
+  for (const auto &size : sizes) {
+    out << std::left << std::setw(first_width) << formatBytes(size.second);
+    for (const path_run &run : runs) {
+      std::stringstream cell;
+      auto it = std::find_if(
+          run.points.begin(), run.points.end(),
+          [&](const sweep_point &p) { return p.count == size.first; });
+      if (it != run.points.end())
+        cell << std::fixed << std::setprecision(2) << it->ns_per_hop
+             << " ns/hop";
+      else
+        cell << "-";
+      out << " | " << std::setw(width) << cell.str();
+    }
+    out << "\n";
+  }
+
+  // 3. Anything that could not run, with the reason
+  for (const path_run &run : runs)
+    if (!run.error.empty())
+      out << memory_path_name(run.path) << ": " << run.error << "\n";
+  out << std::right;
+}
@@ -0,0 +1,72 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "sweep_driver.h"
+#include "utils.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The ways a kernel can read a read-only table, each with its own chase
+// kernel. GPUs send them through different caches (L1, constant / uniform,
+// texture), with different latency and different size limits.
+enum class memory_path {
+  storage,          // lat_comp.comp: coherent storage buffer
+  storage_readonly, // chase_ssbo_ro.comp: readonly restrict storage buffer
+  uniform,          // chase_ubo.comp: uniform buffer
+  uniform_texel,    // chase_utexel.comp: uniform texel buffer
+  storage_texel,    // chase_stexel.comp: storage texel buffer
+  image_1d,         // chase_image1d.comp: sampled 1D image
+  image_2d,         // chase_image2d.comp: sampled 2D image, Morton order
+  push_constant,    // chase_push.comp: push constants
+};
+
+// "ssbo", "ssbo-ro", "ubo", "utexel", "stexel", "image1d", "image2d", "push"
+const char *memory_path_name(memory_path path);
+// Inverse of memory_path_name; throws std::invalid_argument.
+memory_path parse_memory_path(const std::string &name);
+// Every path, in the order above.
+std::vector<memory_path> all_memory_paths();
+
+// Longest chain, in uint32_t nodes, `path` can hold on this device: the
+// device's range, texel count or image dimension limit for it.
+uint64_t memory_path_capacity(const gpu_system &gpu, memory_path path);
+
+// One column of the report: the chase sweep through one path. Sizes over
+// the path's capacity are left out.
+struct path_run {
+  memory_path path = memory_path::storage;
+  std::vector<sweep_point> points;
+  std::string error; // non-empty when the path could not be measured
+};
+
+// Chases the same chains (size N built from seed + N) through every path in
+// `paths`; each point is the median of `repetitions` dispatches of `hops`
+// hops after one warm-up.
+std::vector<path_run> run_memory_paths(gpu_system &gpu,
+                                       const std::vector<memory_path> &paths,
+                                       const std::vector<uint32_t> &counts,
+                                       uint32_t hops = 1000000,
+                                       uint32_t repetitions = 3,
+                                       uint64_t seed = random_seed());
+
+// One table: a row per size, a column per path ("-" past its capacity).
+void print_memory_path_report(const std::vector<path_run> &runs,
+                              std::ostream &out);
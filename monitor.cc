@@ -0,0 +1,327 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "monitor.h"
+#include "sweep_driver.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+double now_seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Label values may hold anything the driver reports; the text format only
+// needs backslash, quote and newline escaped.
+std::string escape_label(const std::string &value) {
+  std::string out;
+  for (char c : value) {
+    if (c == '\n') {
+      out += "\\n";
+      continue;
+    }
+    if (c == '\\' || c == '"')
+      out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+} // namespace
+
+void latency_monitor::create(gpu_system &gpu) {
+  gpu_ = &gpu;
+  VkDevice dev = gpu.logical_device_handle;
+  VkPhysicalDevice phys = gpu.physical_device_handle;
+
+  // 1. Pipelines, prepared once for the life of the monitor
+  chase_.specialization_constants = {hops};
+  chase_.prepare(dev, "lat_comp.spv", gpu.push_descriptor_supported);
+  if (bandwidth_bytes > 0) {
+    reader_.specialization_constants = {1}; // one pass
+    reader_.group_count_x = std::min<uint32_t>(
+        1024, gpu.device_properties.limits.maxComputeWorkGroupCount[0]);
+    reader_.prepare(dev, "bw_read.spv", gpu.push_descriptor_supported);
+  }
+
+  // 2. Buffers and chains; sized up front so probes never move once their
+  // descriptors point at them
+  probes_.resize(sizes.size() + (bandwidth_bytes > 0 ? 1 : 0));
+  std::vector<uint32_t> scratch;
+  for (size_t i = 0; i < probes_.size(); i++) {
+    probe &p = probes_[i];
+    p.bandwidth = i == sizes.size();
+    p.bytes = p.bandwidth ? bandwidth_bytes : sizes[i];
+    uint32_t count = (uint32_t)(p.bytes / sizeof(uint32_t));
+    if (p.bandwidth) {
+      p.nodes.create(dev, phys, p.bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    } else {
+      p.nodes.create(dev, phys, p.bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      upload_shuffled_chain(p.nodes, count, scratch, chain_layout::random,
+                            seed + count);
+    }
+    p.result.create(dev, phys, sizeof(uint32_t),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // 3. One recorded command buffer per probe, resubmitted every sample
+    record(p, p.bandwidth ? reader_ : chase_);
+  }
+
+  // 4. Labels every series carries, so a fleet can be sliced by hardware
+  // (the driver formatted as in baselines and NDJSON/CSV, so they join)
+  device_labels_ = {{"device", gpu.device_properties.deviceName},
+                    {"uuid", gpu.device_uuid},
+                    {"driver", formatDriverVersion(
+                                   gpu.device_properties.vendorID,
+                                   gpu.device_properties.driverVersion)}};
+
+  // 5. The socket, if asked for; a stale one from a killed run is replaced
+  if (!socket_path.empty()) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+      throw std::runtime_error("socket path too long: " + socket_path);
+    std::strcpy(address.sun_path, socket_path.c_str());
+    ::unlink(socket_path.c_str());
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0 ||
+        ::bind(listen_fd_, (sockaddr *)&address, sizeof(address)) != 0 ||
+        ::listen(listen_fd_, 8) != 0)
+      throw std::runtime_error("cannot listen on " + socket_path + ": " +
+                               std::strerror(errno));
+  }
+}
+
+void latency_monitor::record(probe &p, shader_pipeline &pipeline) {
+  VkDevice dev = gpu_->logical_device_handle;
+  p.stopwatch.create(dev, gpu_->physical_device_handle);
+
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = gpu_->compute_queue_family_index;
+  VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &p.command_pool));
+  VkCommandBufferAllocateInfo cb_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cb_info.commandPool = p.command_pool;
+  cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cb_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &p.command_buffer));
+
+  // The timer resets its own query pool, so the recording stays valid for
+  // every resubmission.
+  pipeline.bind_blocks(dev, {&p.nodes, &p.result});
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  vkBeginCommandBuffer(p.command_buffer, &begin_info);
+  pipeline.record(p.command_buffer, p.stopwatch);
+  vkEndCommandBuffer(p.command_buffer);
+
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &p.fence));
+}
+
+std::vector<monitor_metric> latency_monitor::sample() {
+  VkDevice dev = gpu_->logical_device_handle;
+  std::vector<monitor_metric> metrics;
+  double gpu_ns_total = 0.0;
+
+  // 1. One probe at a time, so no probe disturbs another's timing
+  for (probe &p : probes_) {
+    VK_CHECK(vkResetFences(dev, 1, &p.fence));
+    VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &p.command_buffer;
+    VK_CHECK(vkQueueSubmit(gpu_->compute_queue_handle, 1, &submit_info,
+                           p.fence));
+    VK_CHECK(vkWaitForFences(dev, 1, &p.fence, VK_TRUE, UINT64_MAX));
+    double ns = p.stopwatch.get_nanoseconds(dev);
+    gpu_ns_total += ns;
+
+    monitor_metric m;
+    m.type = "gauge";
+    m.labels = device_labels_;
+    if (p.bandwidth) {
+      m.name = "m4_profiler_read_bandwidth_gbps";
+      m.help = "Streaming read bandwidth of a device-local buffer, GB/s.";
+      m.value = (double)p.bytes / ns;
+    } else {
+      m.name = "m4_profiler_chase_latency_ns";
+      m.help = "Dependent-load latency of a shuffled pointer chase, ns/hop.";
+      m.labels.push_back({"size_bytes", std::to_string(p.bytes)});
+      m.value = ns / hops;
+    }
+    metrics.push_back(m);
+  }
+  samples_++;
+
+  // 2. Bookkeeping series, so a dashboard can tell stale data from drift
+  auto bookkeeping = [&](const char *name, const char *help, const char *type,
+                         double value) {
+    monitor_metric m;
+    m.name = name;
+    m.help = help;
+    m.type = type;
+    m.labels = device_labels_;
+    m.value = value;
+    metrics.push_back(m);
+  };
+  bookkeeping("m4_profiler_sample_gpu_seconds",
+              "GPU time the last sample took.", "gauge", gpu_ns_total * 1e-9);
+  bookkeeping("m4_profiler_last_sample_timestamp_seconds",
+              "Unix time of the last sample.", "gauge",
+              std::chrono::duration<double>(
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count());
+  bookkeeping("m4_profiler_samples_total", "Samples taken since start.",
+              "counter", (double)samples_);
+  return metrics;
+}
+
+std::string
+latency_monitor::exposition(const std::vector<monitor_metric> &metrics) {
+  std::ostringstream out;
+  out << std::setprecision(9);
+  std::set<std::string> described;
+  for (const monitor_metric &m : metrics) {
+    if (described.insert(m.name).second) {
+      out << "# HELP " << m.name << " " << m.help << "\n";
+      out << "# TYPE " << m.name << " " << m.type << "\n";
+    }
+    out << m.name;
+    if (!m.labels.empty()) {
+      out << "{";
+      for (size_t i = 0; i < m.labels.size(); i++)
+        out << (i ? "," : "") << m.labels[i].first << "=\""
+            << escape_label(m.labels[i].second) << "\"";
+      out << "}";
+    }
+    out << " " << m.value << "\n";
+  }
+  return out.str();
+}
+
+void latency_monitor::publish(const std::string &text) {
+  latest_ = text;
+  if (textfile_path.empty())
+    return;
+  // The collector reads whenever it likes; rename makes the swap atomic.
+  std::string temporary = textfile_path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    file << text;
+    if (!file)
+      throw std::runtime_error("cannot write " + temporary);
+  }
+  if (std::rename(temporary.c_str(), textfile_path.c_str()) != 0)
+    throw std::runtime_error("cannot rename " + temporary + " to " +
+                             textfile_path + ": " + std::strerror(errno));
+}
+
+void latency_monitor::serve_until(double deadline_seconds,
+                                  const volatile std::sig_atomic_t &stop) {
+  while (!stop) {
+    double left = deadline_seconds - now_seconds();
+    if (left <= 0.0)
+      return;
+    // Short slices so a stop request is seen promptly even when the signal
+    // lands outside poll().
+    int timeout_ms = (int)std::min(left * 1000.0, 250.0) + 1;
+    if (listen_fd_ < 0) {
+      ::poll(nullptr, 0, timeout_ms);
+      continue;
+    }
+    pollfd listener{listen_fd_, POLLIN, 0};
+    if (::poll(&listener, 1, timeout_ms) <= 0)
+      continue; // timeout or EINTR
+    int client = ::accept(listen_fd_, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    // A scraper gets the latest text and EOF; nothing is read from it.
+    size_t sent = 0;
+    while (sent < latest_.size()) {
+      ssize_t n = ::send(client, latest_.data() + sent, latest_.size() - sent,
+                         MSG_NOSIGNAL);
+      if (n <= 0)
+        break;
+      sent += (size_t)n;
+    }
+    ::close(client);
+  }
+}
+
+void latency_monitor::run(const volatile std::sig_atomic_t &stop) {
+  while (!stop) {
+    // 1. Sample and publish
+    double start = now_seconds();
+    publish(exposition(sample()));
+    double busy = now_seconds() - start;
+
+    // 2. Wait the interval, or longer if the sample was slow enough that
+    // the interval alone would exceed the duty cycle
+    double wait = interval_seconds;
+    if (max_duty_cycle > 0.0)
+      wait = std::max(wait, busy / max_duty_cycle - busy);
+    serve_until(now_seconds() + wait, stop);
+  }
+}
+
+void latency_monitor::destroy() {
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    ::unlink(socket_path.c_str());
+    listen_fd_ = -1;
+  }
+  if (!gpu_)
+    return;
+  VkDevice dev = gpu_->logical_device_handle;
+  vkDeviceWaitIdle(dev);
+  for (probe &p : probes_) {
+    vkDestroyFence(dev, p.fence, nullptr);
+    vkDestroyCommandPool(dev, p.command_pool, nullptr);
+    p.stopwatch.destroy(dev);
+    p.nodes.destroy(VK_NULL_HANDLE);
+    p.result.destroy(VK_NULL_HANDLE);
+  }
+  probes_.clear();
+  chase_.destroy(dev);
+  if (bandwidth_bytes > 0)
+    reader_.destroy(dev);
+  gpu_ = nullptr;
+}
@@ -0,0 +1,102 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One exported value, in Prometheus terms.
+struct monitor_metric {
+  std::string name; // e.g. "m4_profiler_chase_latency_ns"
+  std::string help;
+  std::string type; // "gauge" or "counter"
+  std::vector<std::pair<std::string, std::string>> labels;
+  double value = 0.0;
+};
+
+// A long-running monitor for latency drift on a node.
+// create() does everything expensive once (device, pipelines, buffers,
+// shuffled chains, recorded command buffers); each sample afterwards just
+// resubmits those command buffers, a few milliseconds of GPU time. Samples
+// are spaced by the interval, stretched when needed so the GPU time spent
+// stays under max_duty_cycle of wall time, and published as Prometheus text:
+// to a textfile-collector file (written to a temporary and renamed, so the
+// collector never sees half a file) and/or to every client of a Unix
+// socket, which gets the latest text and is then closed.
+class latency_monitor {
+public:
+  // Chain sizes sampled each round, in bytes.
+  std::vector<uint64_t> sizes = {16 * 1024, 256 * 1024, 4 * 1024 * 1024,
+                                 64 * 1024 * 1024};
+  // Hops per latency dispatch: about a millisecond at DRAM latency.
+  uint32_t hops = 20000;
+  // Bytes bw_read.spv streams once per sample (0 = no bandwidth metric).
+  VkDeviceSize bandwidth_bytes = 64 * 1024 * 1024;
+  double interval_seconds = 60.0;
+  double max_duty_cycle = 0.01;
+  std::string textfile_path; // "" = no file
+  std::string socket_path;   // "" = no socket
+  // Fixed, so every sample (and every restart) walks the same chains.
+  uint64_t seed = 0;
+
+  void create(gpu_system &gpu);
+
+  // One round over every probe.
+  std::vector<monitor_metric> sample();
+
+  // Samples and publishes until `stop` becomes non-zero (set it from a
+  // SIGINT / SIGTERM handler), serving the socket between samples.
+  void run(const volatile std::sig_atomic_t &stop);
+
+  // The text exposition format of `metrics`, HELP and TYPE once per name.
+  static std::string exposition(const std::vector<monitor_metric> &metrics);
+
+  void destroy();
+
+private:
+  // One pre-recorded dispatch and everything it reads.
+  struct probe {
+    memory_block nodes, result;
+    timer stopwatch;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    uint64_t bytes = 0;
+    bool bandwidth = false; // bw_read.spv, else the chase
+  };
+
+  void record(probe &p, shader_pipeline &pipeline);
+  void publish(const std::string &text);
+  void serve_until(double deadline_seconds,
+                   const volatile std::sig_atomic_t &stop);
+
+  gpu_system *gpu_ = nullptr;
+  shader_pipeline chase_, reader_;
+  std::vector<probe> probes_;
+  std::vector<std::pair<std::string, std::string>> device_labels_;
+  uint64_t samples_ = 0;
+  int listen_fd_ = -1;
+  std::string latest_; // last exposition, served to socket clients
+};
@@ -0,0 +1,309 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "multi_device.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include "utils.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Holds every thread until the last one arrives, so concurrent chasers
+// start their dispatches together rather than as each finishes shuffling.
+class start_gate {
+public:
+  explicit start_gate(size_t expected) : expected_(expected) {}
+
+  void arrive_and_wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (++arrived_ >= expected_) {
+      released_.notify_all();
+      return;
+    }
+    released_.wait(lock, [this] { return arrived_ >= expected_; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable released_;
+  size_t arrived_ = 0;
+  size_t expected_;
+};
+
+// Runs body(q) for every q < queues on a thread of its own and joins them
+// all. The first exception a body threw is rethrown here, after the join,
+// instead of escaping its thread (which would end in std::terminate).
+void run_per_queue(size_t queues, const std::function<void(size_t)> &body) {
+  std::vector<std::exception_ptr> errors(queues);
+  std::vector<std::thread> workers;
+  for (size_t q = 0; q < queues; q++)
+    workers.emplace_back([&, q] {
+      try {
+        body(q);
+      } catch (...) {
+        errors[q] = std::current_exception();
+      }
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+  for (const std::exception_ptr &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+// A whole sweep on one (device, family), start to finish, in this thread.
+device_run sweep_one(const gpu_description &device, uint32_t queue_family,
+                     const std::vector<uint32_t> &counts,
+                     const std::string &shader_path) {
+  device_run run;
+  run.device = device;
+  run.queue_family = queue_family;
+
+  try {
+    gpu_system gpu;
+    gpu.initialize(device.device_index, queue_family);
+
+    shader_pipeline pipeline;
+    pipeline.prepare(gpu.logical_device_handle, shader_path,
+                     gpu.push_descriptor_supported);
+
+    sweep_driver sweep;
+    sweep.create(gpu, pipeline);
+    sweep.run(counts,
+              [&](const sweep_point &point) { run.points.push_back(point); });
+    sweep.destroy();
+
+    pipeline.destroy(gpu.logical_device_handle);
+    gpu.shutdown();
+  } catch (const std::exception &e) {
+    run.error = e.what();
+  }
+  return run;
+}
+
+// All compute families of one device, one after the other.
+std::vector<device_run> sweep_device(const gpu_description &device,
+                                     const std::vector<uint32_t> &counts,
+                                     const std::string &shader_path) {
+  std::vector<device_run> runs;
+  for (uint32_t family : device.compute_queue_families)
+    runs.push_back(sweep_one(device, family, counts, shader_path));
+  return runs;
+}
+
+std::string column_title(const device_run &run) {
+  std::stringstream ss;
+  ss << "[" << run.device.device_index << "] " << run.device.name << " (qf"
+     << run.queue_family << ")";
+  return ss.str();
+}
+
+} // namespace
+
+std::vector<device_run> run_all_devices(const std::vector<uint32_t> &counts,
+                                        const std::string &shader_path,
+                                        bool parallel) {
+  std::vector<gpu_description> devices = gpu_system::enumerate();
+
+  // Results land in per-device slots so the report order is the
+  // enumeration order regardless of which thread finishes first.
+  std::vector<std::vector<device_run>> per_device(devices.size());
+  std::vector<std::thread> workers;
+
+  for (size_t d = 0; d < devices.size(); d++) {
+    if (devices[d].device_type == VK_PHYSICAL_DEVICE_TYPE_CPU)
+      continue; // measured alone below
+    if (parallel) {
+      workers.emplace_back([&, d] {
+        per_device[d] = sweep_device(devices[d], counts, shader_path);
+      });
+    } else {
+      per_device[d] = sweep_device(devices[d], counts, shader_path);
+    }
+  }
+  for (std::thread &worker : workers)
+    worker.join();
+
+  for (size_t d = 0; d < devices.size(); d++) {
+    if (devices[d].device_type == VK_PHYSICAL_DEVICE_TYPE_CPU)
+      per_device[d] = sweep_device(devices[d], counts, shader_path);
+  }
+
+  std::vector<device_run> runs;
+  for (std::vector<device_run> &device_runs : per_device)
+    runs.insert(runs.end(), device_runs.begin(), device_runs.end());
+  return runs;
+}
+
+void print_device_report(const std::vector<device_run> &runs,
+                         std::ostream &out) {
+  const int first_width = 12;
+  std::vector<int> widths;
+  for (const device_run &run : runs)
+    widths.push_back(std::max<int>(12, (int)column_title(run).size()));
+
+  // 1. Header
+  out << std::left << std::setw(first_width) << "Size";
+  for (size_t c = 0; c < runs.size(); c++)
+    out << " | " << std::setw(widths[c]) << column_title(runs[c]);
+  out << "\n";
+
+  // 2. One row per size. Every successful run measured the same counts in
+  // the same order, so the first successful run supplies the row labels.
+  const device_run *reference = nullptr;
+  for (const device_run &run : runs)
+    if (run.error.empty()) {
+      reference = &run;
+      break;
+    }
+
+  if (reference != nullptr) {
+    for (size_t r = 0; r < reference->points.size(); r++) {
+      out << std::left << std::setw(first_width)
+          << formatBytes(reference->points[r].bytes);
+      for (size_t c = 0; c < runs.size(); c++) {
+        std::stringstream cell;
+        if (r < runs[c].points.size())
+          cell << std::fixed << std::setprecision(2)
+               << runs[c].points[r].ns_per_hop << " ns/hop";
+        else
+          cell << "-";
+        out << " | " << std::setw(widths[c]) << cell.str();
+      }
+      out << "\n";
+    }
+  }
+
+  // 3. Anything that could not run, with the reason
+  for (const device_run &run : runs)
+    if (!run.error.empty())
+      out << column_title(run) << ": " << run.error << "\n";
+  out << std::right;
+}
+
+std::vector<queue_interference_row>
+run_queue_interference(uint32_t device_index, uint32_t queue_count,
+                       const std::vector<uint32_t> &counts,
+                       const std::string &shader_path) {
+  gpu_system gpu;
+  gpu.initialize(device_index, gpu_system::any_queue_family, queue_count);
+  VkDevice dev = gpu.logical_device_handle;
+  size_t queues = gpu.compute_queues.size();
+
+  // Everything a chaser touches is per queue: the descriptor allocator in
+  // shader_pipeline is not meant to be shared between threads.
+  std::vector<shader_pipeline> pipelines(queues);
+  std::vector<timer> stopwatches(queues);
+  auto release = [&] {
+    for (size_t q = 0; q < queues; q++) {
+      stopwatches[q].destroy(dev);
+      pipelines[q].destroy(dev);
+    }
+    gpu.shutdown();
+  };
+
+  // The chains of a failed size are freed as the error unwinds; the
+  // per-queue objects and the device are released before it leaves.
+  std::vector<queue_interference_row> rows;
+  try {
+    for (size_t q = 0; q < queues; q++) {
+      pipelines[q].prepare(dev, shader_path, gpu.push_descriptor_supported);
+      stopwatches[q].create(dev, gpu.physical_device_handle);
+    }
+
+    const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const double hops = 1000000.0; // lat_comp.comp
+
+    for (uint32_t count : counts) {
+      VkDeviceSize size = VkDeviceSize(count) * sizeof(uint32_t);
+      queue_interference_row row;
+      row.count = count;
+      row.concurrent_ns_per_hop.resize(queues);
+
+      // 1. One chain per queue, so chasers never share cache lines
+      std::vector<memory_block> nodes(queues), results(queues);
+      run_per_queue(queues, [&](size_t q) {
+        std::vector<uint32_t> scratch;
+        nodes[q].create(dev, gpu.physical_device_handle, size,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, flags);
+        results[q].create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, flags);
+        upload_shuffled_chain(nodes[q], count, scratch);
+      });
+
+      // 2. Baseline: queue 0 on its own
+      pipelines[0].bind_blocks(dev, {&nodes[0], &results[0]});
+      pipelines[0].run(dev, gpu.compute_queues[0],
+                       gpu.compute_queue_family_index, stopwatches[0]);
+      row.solo_ns_per_hop = stopwatches[0].get_nanoseconds(dev) / hops;
+
+      // 3. Every queue at once
+      // A worker that fails to bind still arrives, or the others would wait
+      // at the gate for ever.
+      start_gate gate(queues);
+      run_per_queue(queues, [&](size_t q) {
+        std::exception_ptr bind_error;
+        try {
+          pipelines[q].bind_blocks(dev, {&nodes[q], &results[q]});
+        } catch (...) {
+          bind_error = std::current_exception();
+        }
+        gate.arrive_and_wait();
+        if (bind_error)
+          std::rethrow_exception(bind_error);
+        pipelines[q].run(dev, gpu.compute_queues[q],
+                         gpu.compute_queue_family_index, stopwatches[q]);
+        row.concurrent_ns_per_hop[q] =
+            stopwatches[q].get_nanoseconds(dev) / hops;
+      });
+
+      rows.push_back(row);
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+  release();
+  return rows;
+}
+
+void print_queue_interference(const std::vector<queue_interference_row> &rows,
+                              std::ostream &out) {
+  for (const queue_interference_row &row : rows) {
+    out << formatBytes(VkDeviceSize(row.count) * sizeof(uint32_t))
+        << " | solo: " << row.solo_ns_per_hop << " ns/hop";
+    for (size_t q = 0; q < row.concurrent_ns_per_hop.size(); q++) {
+      double ns = row.concurrent_ns_per_hop[q];
+      out << " | q" << q << ": " << ns << " ns/hop (x" << std::fixed
+          << std::setprecision(2) << ns / row.solo_ns_per_hop << ")"
+          << std::defaultfloat;
+    }
+    out << std::endl;
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "sweep_driver.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One column of the comparative report: a sweep on one queue family of one
+// device.
+struct device_run {
+  gpu_description device;
+  uint32_t queue_family = 0;
+  std::vector<sweep_point> points;
+  std::string error; // non-empty when this device could not be measured
+};
+
+// Runs the latency sweep, and only that (random chains, default settings),
+// on every compute queue family of every device; the other modes measure one
+// device at a time.
+// With `parallel`, each GPU gets its own host thread (own instance, own
+// device, so nothing is shared); families of one device still go one after
+// the other so they don't disturb each other. CPU-type devices such as
+// lavapipe always run alone at the end, since they compete with every other
+// host thread for the cores they are measuring.
+std::vector<device_run> run_all_devices(const std::vector<uint32_t> &counts,
+                                        const std::string &shader_path,
+                                        bool parallel);
+
+// One table: a row per size, a column per (device, family).
+void print_device_report(const std::vector<device_run> &runs,
+                         std::ostream &out);
+
+// Cross-queue interference on one device: for each size, a chaser alone on
+// queue 0, then one chaser per queue released together.
+struct queue_interference_row {
+  uint32_t count = 0;
+  double solo_ns_per_hop = 0.0;
+  std::vector<double> concurrent_ns_per_hop; // indexed by queue
+};
+
+std::vector<queue_interference_row>
+run_queue_interference(uint32_t device_index, uint32_t queue_count,
+                       const std::vector<uint32_t> &counts,
+                       const std::string &shader_path);
+
+void print_queue_interference(const std::vector<queue_interference_row> &rows,
+                              std::ostream &out);
@@ -0,0 +1,240 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "numa.h"
+#include "cpu_clock.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Enough for any machine this runs on; the kernel reads maxnode - 1 bits.
+constexpr int max_nodes = 64;
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parse_list(const std::string &text) {
+  std::vector<int> ids;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find(',', pos);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string range = text.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    try {
+      int lo = std::stoi(range.substr(0, dash));
+      int hi =
+          dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+      for (int id = lo; id <= hi; id++)
+        ids.push_back(id);
+    } catch (const std::exception &) {
+      // blank or trailing newline
+    }
+    pos = end + 1;
+  }
+  return ids;
+}
+
+std::vector<int> read_list(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line))
+    return {};
+  return parse_list(line);
+}
+
+int current_cpu() {
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : cpu;
+#else
+  return 0;
+#endif
+}
+
+// The node local / remote mean for `home_cpu` among `nodes` (two or more).
+int anchor_node(numa_policy policy, int home_cpu,
+                const std::vector<int> &nodes) {
+  int home = numa_node_of_cpu(home_cpu < 0 ? current_cpu() : home_cpu);
+  if (policy != numa_policy::remote)
+    return home;
+  auto it = std::upper_bound(nodes.begin(), nodes.end(), home);
+  return it == nodes.end() ? nodes.front() : *it;
+}
+
+// The policy mode and node mask a placement resolves to on this machine.
+struct resolved_policy {
+  int mode = 0; // MPOL_*; 0 (MPOL_DEFAULT) means leave things alone
+  unsigned long mask = 0;
+  std::string applied;
+};
+
+resolved_policy resolve(const numa_placement &placement, int home_cpu) {
+  resolved_policy r;
+  std::vector<int> nodes = numa_memory_nodes();
+  if (placement.policy == numa_policy::first_touch) {
+    r.applied = "first-touch";
+    return r;
+  }
+  if (nodes.size() < 2) {
+    r.applied = "first-touch (single node, " + placement.name() + " ignored)";
+    return r;
+  }
+#ifdef __linux__
+  int target = 0;
+  switch (placement.policy) {
+  case numa_policy::interleave:
+    r.mode = MPOL_INTERLEAVE;
+    for (int n : nodes)
+      if (n < max_nodes)
+        r.mask |= 1ul << n;
+    r.applied = "interleave " + std::to_string(nodes.front()) + "-" +
+                std::to_string(nodes.back());
+    return r;
+  case numa_policy::node:
+    target = placement.node;
+    if (std::find(nodes.begin(), nodes.end(), target) == nodes.end())
+      throw std::runtime_error("NUMA node " + std::to_string(target) +
+                               " has no memory or does not exist");
+    break;
+  default:
+    target = anchor_node(placement.policy, home_cpu, nodes);
+    break;
+  }
+  r.mode = MPOL_BIND;
+  r.mask = target < max_nodes ? 1ul << target : 0;
+  r.applied = "node " + std::to_string(target);
+#endif
+  return r;
+}
+
+} // namespace
+
+numa_placement numa_placement::parse(const std::string &text) {
+  numa_placement p;
+  if (text == "first-touch")
+    p.policy = numa_policy::first_touch;
+  else if (text == "local")
+    p.policy = numa_policy::local;
+  else if (text == "remote")
+    p.policy = numa_policy::remote;
+  else if (text == "interleave")
+    p.policy = numa_policy::interleave;
+  else if (text.rfind("node:", 0) == 0) {
+    p.policy = numa_policy::node;
+    p.node = std::stoi(text.substr(5));
+  } else
+    throw std::invalid_argument("unknown NUMA placement: " + text);
+  return p;
+}
+
+numa_placement numa_placement::anchored(int home_cpu) const {
+  if (policy != numa_policy::local && policy != numa_policy::remote)
+    return *this;
+  std::vector<int> nodes = numa_memory_nodes();
+  if (nodes.size() < 2)
+    return *this;
+  numa_placement p;
+  p.policy = numa_policy::node;
+  p.node = anchor_node(policy, home_cpu, nodes);
+  return p;
+}
+
+std::string numa_placement::name() const {
+  switch (policy) {
+  case numa_policy::local:
+    return "local";
+  case numa_policy::remote:
+    return "remote";
+  case numa_policy::interleave:
+    return "interleave";
+  case numa_policy::node:
+    return "node:" + std::to_string(node);
+  default:
+    return "first-touch";
+  }
+}
+
+std::vector<int> numa_memory_nodes() {
+  std::vector<int> nodes = read_list("/sys/devices/system/node/has_memory");
+  if (nodes.empty())
+    nodes = read_list("/sys/devices/system/node/online");
+  if (nodes.empty())
+    nodes = {0};
+  return nodes;
+}
+
+int numa_node_of_cpu(int cpu) {
+  for (int node : read_list("/sys/devices/system/node/online")) {
+    std::vector<int> cpus = read_list("/sys/devices/system/node/node" +
+                                      std::to_string(node) + "/cpulist");
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+      return node;
+  }
+  return 0;
+}
+
+std::vector<int> numa_node_cpus(int node) {
+  std::vector<int> cpus;
+  for (int cpu : allowed_cpus())
+    if (numa_node_of_cpu(cpu) == node)
+      cpus.push_back(cpu);
+  return cpus;
+}
+
+std::string bind_numa_range(void *addr, size_t bytes,
+                            const numa_placement &placement, int home_cpu) {
+  resolved_policy r = resolve(placement, home_cpu);
+#ifdef __linux__
+  if (r.mode != MPOL_DEFAULT &&
+      syscall(SYS_mbind, addr, bytes, r.mode, &r.mask, max_nodes + 1, 0) != 0)
+    return "first-touch (mbind to " + r.applied + " refused)";
+#else
+  (void)addr;
+  (void)bytes;
+#endif
+  return r.applied;
+}
+
+scoped_numa_policy::scoped_numa_policy(const numa_placement &placement,
+                                       int home_cpu) {
+  resolved_policy r = resolve(placement, home_cpu);
+  applied = r.applied;
+#ifdef __linux__
+  if (r.mode != MPOL_DEFAULT) {
+    active_ =
+        syscall(SYS_set_mempolicy, r.mode, &r.mask, max_nodes + 1) == 0;
+    if (!active_)
+      applied = "first-touch (set_mempolicy to " + r.applied + " refused)";
+  }
+#endif
+}
+
+scoped_numa_policy::~scoped_numa_policy() {
+#ifdef __linux__
+  if (active_)
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+#endif
+}
@@ -0,0 +1,79 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Which NUMA node host memory comes from.
+enum class numa_policy {
+  first_touch, // the kernel default: wherever the first writer runs
+  local,       // bound to the node of the home CPU
+  remote,      // bound to the next node after the home CPU's one
+  interleave,  // pages spread round-robin over every memory node
+  node,        // bound to one explicit node
+};
+
+struct numa_placement {
+  numa_policy policy = numa_policy::first_touch;
+  int node = 0; // only for numa_policy::node
+
+  // "local", "remote", "interleave", "first-touch" or "node:N"; throws
+  // std::invalid_argument for anything else.
+  static numa_placement parse(const std::string &text);
+  std::string name() const;
+
+  // local / remote turned into the node they mean for `home_cpu` (-1 = the
+  // CPU the caller is on), so the placement can be applied later from any
+  // thread; everything else, and anything on a single node, is unchanged.
+  numa_placement anchored(int home_cpu = -1) const;
+};
+
+// Nodes that have memory, ascending ({0} without NUMA support).
+std::vector<int> numa_memory_nodes();
+
+// Node a logical CPU belongs to (0 without NUMA support).
+int numa_node_of_cpu(int cpu);
+
+// The allowed CPUs (see allowed_cpus) on one node.
+std::vector<int> numa_node_cpus(int node);
+
+// Binds [addr, addr + bytes) with mbind before anything touches it. `home_cpu`
+// anchors local/remote (-1 = the CPU the caller is on). Returns what was
+// actually applied, e.g. "node 1" or "interleave 0-1"; on a single-node
+// machine or without NUMA support nothing is bound and the result says so.
+// Throws std::runtime_error for a node that does not exist.
+std::string bind_numa_range(void *addr, size_t bytes,
+                            const numa_placement &placement, int home_cpu = -1);
+
+// Applies a placement to every allocation the calling thread faults in while
+// it is alive (set_mempolicy), then restores the default. This is how memory
+// a driver allocates on our behalf, like host-visible memory_blocks and
+// their staging copies, is steered: those pages are not ours to mbind.
+class scoped_numa_policy {
+public:
+  scoped_numa_policy(const numa_placement &placement, int home_cpu = -1);
+  ~scoped_numa_policy();
+  scoped_numa_policy(const scoped_numa_policy &) = delete;
+  scoped_numa_policy &operator=(const scoped_numa_policy &) = delete;
+
+  std::string applied; // as returned by bind_numa_range
+
+private:
+  bool active_ = false;
+};
@@ -0,0 +1,102 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "numa_matrix.h"
+#include "cpu_bandwidth.h"
+#include "cpu_latency.h"
+#include "numa.h"
+
+#include <iomanip>
+
+numa_matrix run_numa_matrix(uint32_t chain_count, page_backing backing) {
+  numa_matrix matrix;
+  matrix.memory_nodes = numa_memory_nodes();
+  for (int node : numa_memory_nodes())
+    if (!numa_node_cpus(node).empty())
+      matrix.cpu_nodes.push_back(node);
+  // Nodes with CPUs but no memory still issue loads.
+  for (int cpu : allowed_cpus()) {
+    int node = numa_node_of_cpu(cpu);
+    bool known = false;
+    for (int n : matrix.cpu_nodes)
+      known |= n == node;
+    if (!known)
+      matrix.cpu_nodes.push_back(node);
+  }
+  matrix.single_node = matrix.memory_nodes.size() < 2;
+
+  uint64_t bytes = (uint64_t)chain_count * sizeof(uint32_t);
+  for (int cpu_node : matrix.cpu_nodes) {
+    std::vector<int> cpus = numa_node_cpus(cpu_node);
+    for (int memory_node : matrix.memory_nodes) {
+      numa_placement placement;
+      placement.policy = numa_policy::node;
+      placement.node = memory_node;
+
+      // 1. Latency: one chaser on the node's first CPU
+      cpu_latency_engine chaser;
+      chaser.cpu = cpus.front();
+      chaser.backing = backing;
+      chaser.placement = placement;
+      chaser.create();
+      double ns = 0.0;
+      chaser.run({chain_count},
+                 [&](const sweep_point &point) { ns = point.ns_per_hop; });
+      matrix.ns_per_hop.push_back(ns);
+
+      // 2. Bandwidth: every CPU of the node reading at once
+      cpu_bandwidth_engine streamer;
+      streamer.kernels = {bandwidth_kernel::read};
+      streamer.include_non_temporal = false;
+      streamer.cpus = cpus;
+      streamer.scale_threads = false;
+      streamer.backing = backing;
+      streamer.placement = placement;
+      streamer.create();
+      double gbs = 0.0;
+      streamer.run({bytes},
+                   [&](const bandwidth_point &point) { gbs = point.gb_per_s; });
+      matrix.gb_per_s.push_back(gbs);
+    }
+  }
+  return matrix;
+}
+
+void print_numa_matrix(const numa_matrix &matrix, std::ostream &out) {
+  if (matrix.single_node)
+    out << "Single NUMA node: no binding applied, one cell measured"
+        << std::endl;
+
+  size_t columns = matrix.memory_nodes.size();
+  auto table = [&](const char *title, const std::vector<double> &values) {
+    out << title << " (rows: CPU node, columns: memory node)" << std::endl;
+    out << std::setw(6) << "node";
+    for (int node : matrix.memory_nodes)
+      out << std::setw(10) << node;
+    out << std::endl;
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < matrix.cpu_nodes.size(); i++) {
+      out << std::setw(6) << matrix.cpu_nodes[i];
+      for (size_t j = 0; j < columns; j++)
+        out << std::setw(10) << values[i * columns + j];
+      out << std::endl;
+    }
+    out << std::defaultfloat;
+  };
+  table("Latency ns/hop", matrix.ns_per_hop);
+  table("Read bandwidth GB/s", matrix.gb_per_s);
+}
@@ -0,0 +1,41 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "host_buffer.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// CPU node x memory node figures. Entry [i * memory_nodes.size() + j] is
+// measured from CPUs of cpu_nodes[i] on memory bound to memory_nodes[j].
+struct numa_matrix {
+  std::vector<int> cpu_nodes;    // nodes with allowed CPUs
+  std::vector<int> memory_nodes; // nodes with memory (may have no CPUs)
+  std::vector<double> ns_per_hop; // one pinned pointer chaser
+  std::vector<double> gb_per_s;   // read kernel on every CPU of the node
+  bool single_node = false;
+};
+
+// Runs the CPU pointer chaser (first CPU of each node, `chain_count` nodes)
+// and the CPU read bandwidth kernel (all of the node's CPUs, same working
+// set) for every (CPU node, memory node) pair. On a single-node machine this
+// is one row and one column measured without any binding.
+numa_matrix run_numa_matrix(uint32_t chain_count,
+                            page_backing backing = page_backing::regular);
+
+void print_numa_matrix(const numa_matrix &matrix, std::ostream &out);
@@ -0,0 +1,357 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "overlap_bench.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "stats.h"
+#include "sweep_driver.h"
+#include "timer.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// VK_KHR_timeline_semaphore entry points, which the loader does not export.
+struct timeline_functions {
+  PFN_vkSignalSemaphoreKHR signal = nullptr;
+  PFN_vkGetSemaphoreCounterValueKHR value = nullptr;
+
+  void load(VkDevice dev) {
+    signal = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(
+        vkGetDeviceProcAddr(dev, "vkSignalSemaphoreKHR"));
+    value = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+        vkGetDeviceProcAddr(dev, "vkGetSemaphoreCounterValueKHR"));
+    if (!signal || !value)
+      throw std::runtime_error("timeline semaphore functions not found");
+  }
+};
+
+VkSemaphore create_timeline(VkDevice dev) {
+  VkSemaphoreTypeCreateInfoKHR type_info{
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR};
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+  type_info.initialValue = 0;
+  VkSemaphoreCreateInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  info.pNext = &type_info;
+  VkSemaphore semaphore;
+  VK_CHECK(vkCreateSemaphore(dev, &info, nullptr, &semaphore));
+  return semaphore;
+}
+
+// One command buffer on one queue, recorded once and resubmitted; every
+// submission waits for the start semaphore and signals `done` one higher.
+struct queue_stream {
+  VkDevice dev = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkCommandPool pool = VK_NULL_HANDLE;
+  VkCommandBuffer cb = VK_NULL_HANDLE;
+  VkSemaphore done = VK_NULL_HANDLE;
+  uint64_t done_value = 0;
+
+  void create(VkDevice device, uint32_t family, VkQueue q,
+              VkPipelineStageFlags stage,
+              const std::function<void(VkCommandBuffer)> &record) {
+    dev = device;
+    queue = q;
+    wait_stage = stage;
+    VkCommandPoolCreateInfo pool_info{
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.queueFamilyIndex = family;
+    VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &pool));
+    VkCommandBufferAllocateInfo cb_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    cb_info.commandPool = pool;
+    cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cb_info.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &cb));
+    VkCommandBufferBeginInfo begin_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    vkBeginCommandBuffer(cb, &begin_info);
+    record(cb);
+    vkEndCommandBuffer(cb);
+    done = create_timeline(dev);
+    done_value = 0;
+  }
+
+  void submit(VkSemaphore start, uint64_t start_value) {
+    done_value++;
+    VkTimelineSemaphoreSubmitInfoKHR values{
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR};
+    values.waitSemaphoreValueCount = 1;
+    values.pWaitSemaphoreValues = &start_value;
+    values.signalSemaphoreValueCount = 1;
+    values.pSignalSemaphoreValues = &done_value;
+    VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.pNext = &values;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &start;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cb;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &done;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+  }
+
+  void destroy() {
+    if (done != VK_NULL_HANDLE)
+      vkDestroySemaphore(dev, done, nullptr);
+    if (pool != VK_NULL_HANDLE)
+      vkDestroyCommandPool(dev, pool, nullptr);
+    done = VK_NULL_HANDLE;
+    pool = VK_NULL_HANDLE;
+  }
+};
+
+// The host side of the start line: submissions queue up behind `start`,
+// then one host signal releases them all.
+struct start_gate {
+  VkDevice dev = VK_NULL_HANDLE;
+  timeline_functions fn;
+  VkSemaphore start = VK_NULL_HANDLE;
+  uint64_t start_value = 0;
+
+  // Submits every stream, releases them together and returns each one's
+  // host time from the release to its done semaphore, plus (last) the time
+  // until all were done.
+  std::vector<double> release(const std::vector<queue_stream *> &streams) {
+    start_value++;
+    for (queue_stream *s : streams)
+      s->submit(start, start_value);
+
+    std::vector<double> seconds(streams.size() + 1, -1.0);
+    size_t pending = streams.size();
+    VkSemaphoreSignalInfoKHR signal_info{
+        VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR};
+    signal_info.semaphore = start;
+    signal_info.value = start_value;
+    clock_type::time_point t0 = clock_type::now();
+    VK_CHECK(fn.signal(dev, &signal_info));
+    // Poll rather than wait, so each stream's finish is seen on its own
+    while (pending > 0) {
+      for (size_t i = 0; i < streams.size(); i++) {
+        if (seconds[i] >= 0.0)
+          continue;
+        uint64_t value = 0;
+        VK_CHECK(fn.value(dev, streams[i]->done, &value));
+        if (value >= streams[i]->done_value) {
+          seconds[i] = std::chrono::duration<double>(clock_type::now() - t0)
+                           .count();
+          pending--;
+        }
+      }
+    }
+    seconds.back() = *std::max_element(seconds.begin(), seconds.end() - 1);
+    return seconds;
+  }
+};
+
+// The copy stream: `copies` whole-buffer copies, src to dst. Copies only
+// ever write dst and the contents are never read, so no barriers.
+void record_copies(VkCommandBuffer cb, const memory_block &src,
+                   const memory_block &dst, uint32_t copies) {
+  VkBufferCopy region{0, 0, src.device_size};
+  for (uint32_t i = 0; i < copies; i++)
+    vkCmdCopyBuffer(cb, src.logical_memory_block_handle,
+                    dst.logical_memory_block_handle, 1, &region);
+}
+
+} // namespace
+
+const char *overlap_kernel_name(overlap_kernel kernel) {
+  return kernel == overlap_kernel::chase ? "chase" : "read";
+}
+
+std::vector<overlap_point> run_overlap(gpu_system &gpu,
+                                       const overlap_options &opts) {
+  if (gpu.transfer_queue_handle == VK_NULL_HANDLE)
+    throw std::runtime_error(
+        "no queue for copies besides the compute queue on this device");
+  if (!gpu.timeline_semaphore_supported)
+    throw std::runtime_error("VK_KHR_timeline_semaphore is not supported");
+
+  VkDevice dev = gpu.logical_device_handle;
+  VkPhysicalDevice phys = gpu.physical_device_handle;
+  const uint32_t reps = std::max(1u, opts.repetitions);
+
+  // 1. The start line and the copy buffers, shared by both kernels
+  start_gate gate;
+  gate.dev = dev;
+  gate.fn.load(dev);
+  gate.start = create_timeline(dev);
+
+  memory_block copy_src, copy_dst;
+  copy_src.create(dev, phys, opts.copy_buffer_bytes,
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  copy_dst.create(dev, phys, opts.copy_buffer_bytes,
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  auto copy_stream = [&](queue_stream &s, uint32_t copies) {
+    s.create(dev, gpu.transfer_queue_family_index, gpu.transfer_queue_handle,
+             VK_PIPELINE_STAGE_TRANSFER_BIT, [&](VkCommandBuffer cb) {
+               record_copies(cb, copy_src, copy_dst, copies);
+             });
+  };
+
+  // One copy alone sets the unit the streams are sized in
+  queue_stream single;
+  copy_stream(single, 1);
+  gate.release({&single}); // warm-up
+  std::vector<double> single_s;
+  for (uint32_t r = 0; r < reps; r++)
+    single_s.push_back(gate.release({&single})[0]);
+  double copy_unit_seconds = summarize(single_s).p50;
+  single.destroy();
+
+  std::vector<overlap_point> points;
+  std::vector<uint32_t> scratch;
+  for (overlap_kernel kernel : {overlap_kernel::chase, overlap_kernel::read}) {
+    overlap_point point;
+    point.kernel = kernel;
+
+    // 2. The kernel, on the compute queue
+    shader_pipeline pipeline;
+    memory_block data, result;
+    VkMemoryPropertyFlags result_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (kernel == overlap_kernel::chase) {
+      uint32_t count = (uint32_t)(opts.chain_bytes / sizeof(uint32_t));
+      pipeline.specialization_constants = {opts.hops};
+      pipeline.prepare(dev, "lat_comp.spv", gpu.push_descriptor_supported);
+      data.create(dev, phys, opts.chain_bytes,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      upload_shuffled_chain(data, count, scratch, chain_layout::random,
+                            count); // seed 0 + N, as the sweeps do
+      point.compute_work = opts.hops;
+    } else {
+      pipeline.specialization_constants = {1}; // one pass
+      pipeline.group_count_x = std::min<uint32_t>(
+          1024, gpu.device_properties.limits.maxComputeWorkGroupCount[0]);
+      pipeline.prepare(dev, "bw_read.spv", gpu.push_descriptor_supported);
+      data.create(dev, phys, opts.read_bytes,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      point.compute_work = (double)opts.read_bytes;
+    }
+    result.create(dev, phys, sizeof(uint32_t),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result_flags);
+
+    // The timer resets its own query pool, so the recording stays valid
+    timer stopwatch;
+    stopwatch.create(dev, phys);
+    pipeline.bind_blocks(dev, {&data, &result});
+    queue_stream compute;
+    // Waits at every stage: the timer's reset and first timestamp sit at the
+    // top of the pipe, and must not run before the release either
+    compute.create(dev, gpu.compute_queue_family_index,
+                   gpu.compute_queue_handle, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                   [&](VkCommandBuffer cb) { pipeline.record(cb, stopwatch); });
+    gate.release({&compute}); // warm-up
+
+    // 3. A copy stream about as long as the kernel alone, so the two
+    // overlap for most of their run
+    std::vector<double> compute_alone_ns, host_alone_s;
+    for (uint32_t r = 0; r < reps; r++) {
+      host_alone_s.push_back(gate.release({&compute})[0]);
+      compute_alone_ns.push_back(stopwatch.get_nanoseconds(dev));
+    }
+    point.compute_alone_ns = summarize(compute_alone_ns).p50;
+    point.copies = (uint32_t)std::clamp(
+        std::lround(point.compute_alone_ns * 1e-9 / copy_unit_seconds), 1l,
+        4096l);
+    point.copy_bytes = (uint64_t)point.copies * opts.copy_buffer_bytes;
+    queue_stream copies;
+    copy_stream(copies, point.copies);
+    gate.release({&copies}); // warm-up
+
+    // 4. Copies alone, then both released together
+    std::vector<double> copy_alone_s, copy_both_s, compute_both_ns, both_s;
+    for (uint32_t r = 0; r < reps; r++)
+      copy_alone_s.push_back(gate.release({&copies})[0]);
+    for (uint32_t r = 0; r < reps; r++) {
+      std::vector<double> s = gate.release({&compute, &copies});
+      copy_both_s.push_back(s[1]);
+      both_s.push_back(s[2]);
+      compute_both_ns.push_back(stopwatch.get_nanoseconds(dev));
+    }
+    point.copy_alone_seconds = summarize(copy_alone_s).p50;
+    point.copy_concurrent_seconds = summarize(copy_both_s).p50;
+    point.compute_concurrent_ns = summarize(compute_both_ns).p50;
+    point.together_seconds = summarize(both_s).p50;
+    point.back_to_back_seconds =
+        summarize(host_alone_s).p50 + point.copy_alone_seconds;
+    points.push_back(point);
+
+    copies.destroy();
+    compute.destroy();
+    stopwatch.destroy(dev);
+    pipeline.destroy(dev);
+  }
+
+  vkDestroySemaphore(dev, gate.start, nullptr);
+  return points;
+}
+
+void print_overlap_report(const gpu_system &gpu,
+                          const std::vector<overlap_point> &points,
+                          std::ostream &out) {
+  out << "Copy queue: family " << gpu.transfer_queue_family_index
+      << (gpu.transfer_queue_dedicated ? " (transfer only)"
+          : gpu.transfer_queue_family_index == gpu.compute_queue_family_index
+              ? " (second queue of the compute family)"
+              : " (shared with graphics or compute)")
+      << std::endl;
+  out << std::fixed << std::setprecision(2);
+  for (const overlap_point &p : points) {
+    bool chase = p.kernel == overlap_kernel::chase;
+    const char *unit = chase ? " ns/hop" : " GB/s";
+    auto rate = [&](double ns) {
+      return chase ? ns / p.compute_work : p.compute_work / ns;
+    };
+    out << std::setw(5) << overlap_kernel_name(p.kernel) << " | alone "
+        << std::setw(8) << rate(p.compute_alone_ns) << unit << " | with copies "
+        << std::setw(8) << rate(p.compute_concurrent_ns) << unit << " ("
+        << std::showpos << p.compute_slowdown() * 100.0 << std::noshowpos
+        << "%)" << std::endl;
+    out << "      | copies x" << p.copies << " alone " << std::setw(7)
+        << p.copy_alone_gbps() << " GB/s | with "
+        << overlap_kernel_name(p.kernel) << " " << std::setw(7)
+        << p.copy_concurrent_gbps() << " GB/s ("
+        << std::showpos << p.copy_slowdown() * 100.0 << std::noshowpos
+        << "%)" << std::endl;
+    out << "      | both done in " << p.together_seconds * 1e3 << " ms vs "
+        << p.back_to_back_seconds * 1e3 << " ms back to back" << std::endl;
+  }
+  out << "(copy GB/s counts bytes copied; the memory sees twice that)"
+      << std::endl;
+  out << std::defaultfloat;
+}
@@ -0,0 +1,87 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// The compute side of an overlap run.
+enum class overlap_kernel {
+  chase, // lat_comp.spv over a shuffled chain, reported in ns/hop
+  read,  // bw_read.spv streaming a device-local buffer, reported in GB/s
+};
+
+// "chase", "read"
+const char *overlap_kernel_name(overlap_kernel kernel);
+
+// One kernel with and without a copy stream beside it; times are medians
+// over the repetitions.
+struct overlap_point {
+  overlap_kernel kernel = overlap_kernel::chase;
+  uint32_t copies = 0;    // vkCmdCopyBuffer calls in the copy stream
+  uint64_t copy_bytes = 0; // bytes the whole stream copies
+  // Host time from the release of the start semaphore to the stream's done
+  // semaphore (transfer families need not have timestamps)
+  double copy_alone_seconds = 0.0;
+  double copy_concurrent_seconds = 0.0;
+  // GPU time of the kernel, from its timestamps
+  double compute_alone_ns = 0.0;
+  double compute_concurrent_ns = 0.0;
+  double compute_work = 0.0; // hops (chase) or bytes read (read)
+  // Host time until both were done, together and one after the other
+  double together_seconds = 0.0;
+  double back_to_back_seconds = 0.0;
+
+  double copy_alone_gbps() const {
+    return copy_bytes / copy_alone_seconds * 1e-9;
+  }
+  double copy_concurrent_gbps() const {
+    return copy_bytes / copy_concurrent_seconds * 1e-9;
+  }
+  // Extra time each side needed with the other running: 0.25 = 25% slower
+  double copy_slowdown() const {
+    return copy_concurrent_seconds / copy_alone_seconds - 1.0;
+  }
+  double compute_slowdown() const {
+    return compute_concurrent_ns / compute_alone_ns - 1.0;
+  }
+};
+
+struct overlap_options {
+  uint64_t copy_buffer_bytes = 256ull * 1024 * 1024; // per vkCmdCopyBuffer
+  uint64_t chain_bytes = 64ull * 1024 * 1024; // past the SLC, like regress
+  uint32_t hops = 200000;
+  uint64_t read_bytes = 256ull * 1024 * 1024;
+  uint32_t repetitions = 5;
+};
+
+// Runs copies on gpu.transfer_queue_handle while each kernel runs on the
+// compute queue. Both submissions wait on one timeline semaphore the host
+// signals, so they start together, and each signals a timeline semaphore of
+// its own when done. The copy stream is sized to take about as long as the
+// kernel does alone. Each kernel is measured alone, the copies alone, then
+// both at once.
+// Throws std::runtime_error when the device has no second queue or no
+// timeline semaphores.
+std::vector<overlap_point> run_overlap(gpu_system &gpu,
+                                       const overlap_options &opts);
+
+void print_overlap_report(const gpu_system &gpu,
+                          const std::vector<overlap_point> &points,
+                          std::ostream &out);
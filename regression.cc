@@ -0,0 +1,311 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "regression.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "sweep_driver.h"
+#include "timer.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Submits one recorded dispatch of `pipeline` over `blocks` `count` times
+// (after one warm-up), collecting GPU time and host submit-to-fence time.
+void time_dispatches(gpu_system &gpu, shader_pipeline &pipeline,
+                     const std::vector<memory_block *> &blocks,
+                     uint32_t count, std::vector<double> &gpu_ns,
+                     std::vector<double> &wall_ns) {
+  VkDevice dev = gpu.logical_device_handle;
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+
+  VkCommandPool pool;
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+  VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &pool));
+  VkCommandBuffer cb;
+  VkCommandBufferAllocateInfo cb_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cb_info.commandPool = pool;
+  cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cb_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &cb));
+
+  // 1. Record once; the same buffer is resubmitted every time
+  pipeline.bind_blocks(dev, blocks);
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  vkBeginCommandBuffer(cb, &begin_info);
+  pipeline.record(cb, stopwatch);
+  vkEndCommandBuffer(cb);
+
+  VkFence done;
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &done));
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cb;
+
+  // 2. Submit and wait, one at a time
+  for (uint32_t i = 0; i <= count; i++) {
+    VK_CHECK(vkResetFences(dev, 1, &done));
+    auto t0 = std::chrono::steady_clock::now();
+    VK_CHECK(vkQueueSubmit(gpu.compute_queue_handle, 1, &submit_info, done));
+    VK_CHECK(vkWaitForFences(dev, 1, &done, VK_TRUE, UINT64_MAX));
+    auto t1 = std::chrono::steady_clock::now();
+    if (i == 0)
+      continue; // warm-up
+    gpu_ns.push_back(stopwatch.get_nanoseconds(dev));
+    wall_ns.push_back(
+        std::chrono::duration<double, std::nano>(t1 - t0).count());
+  }
+
+  vkDestroyFence(dev, done, nullptr);
+  vkDestroyCommandPool(dev, pool, nullptr);
+  stopwatch.destroy(dev);
+}
+
+metric_result make_metric(const std::string &name, const std::string &unit,
+                          bool higher_is_better,
+                          const std::vector<double> &samples,
+                          double confidence) {
+  metric_result m;
+  m.name = name;
+  m.unit = unit;
+  m.higher_is_better = higher_is_better;
+  m.ci = mean_confidence_interval(samples, confidence);
+  return m;
+}
+
+// "4MB", "256KB": whole binary units only, so names stay file-friendly.
+std::string size_label(uint64_t bytes) {
+  const char *units[] = {"B", "KB", "MB", "GB"};
+  int i = 0;
+  while (bytes >= 1024 && bytes % 1024 == 0 && i < 3) {
+    bytes /= 1024;
+    i++;
+  }
+  return std::to_string(bytes) + units[i];
+}
+
+} // namespace
+
+std::vector<metric_result> run_regression_set(gpu_system &gpu,
+                                              const regression_options &opts) {
+  VkDevice dev = gpu.logical_device_handle;
+  std::vector<metric_result> metrics;
+
+  // 1. Latency per level, through the ordinary sweep
+  {
+    const std::vector<uint64_t> level_bytes = {
+        16 * 1024, 256 * 1024, 4 * 1024 * 1024, 64 * 1024 * 1024,
+        512ull * 1024 * 1024};
+    std::vector<uint32_t> counts;
+    for (uint64_t bytes : level_bytes)
+      counts.push_back((uint32_t)(bytes / sizeof(uint32_t)));
+
+    shader_pipeline chase;
+    chase.prepare(dev, "lat_comp.spv", gpu.push_descriptor_supported);
+    sweep_driver sweep;
+    sweep.repetitions = opts.repetitions;
+    sweep.seed = 0; // the same chains every run, so only the device varies
+    std::map<uint32_t, std::vector<double>> samples;
+    sweep.create(gpu, chase);
+    sweep.run(counts, [&](const sweep_point &point) {
+      samples[point.count].push_back(point.ns_per_hop);
+    });
+    sweep.destroy();
+    chase.destroy(dev);
+
+    for (size_t i = 0; i < counts.size(); i++)
+      metrics.push_back(make_metric("latency_" + size_label(level_bytes[i]),
+                                    "ns/hop", false, samples[counts[i]],
+                                    opts.confidence));
+  }
+
+  // 2. Streaming read bandwidth
+  {
+    const VkDeviceSize bytes = 256ull * 1024 * 1024;
+    const uint32_t passes = 4;
+    shader_pipeline reader;
+    reader.specialization_constants = {passes};
+    reader.group_count_x = std::min<uint32_t>(
+        1024, gpu.device_properties.limits.maxComputeWorkGroupCount[0]);
+    reader.prepare(dev, "bw_read.spv", gpu.push_descriptor_supported);
+
+    memory_block src, result;
+    src.create(dev, gpu.physical_device_handle, bytes,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    std::vector<double> gpu_ns, wall_ns, gb_per_s;
+    time_dispatches(gpu, reader, {&src, &result}, opts.repetitions, gpu_ns,
+                    wall_ns);
+    for (double ns : gpu_ns)
+      gb_per_s.push_back((double)bytes * passes / ns);
+    metrics.push_back(make_metric("read_bandwidth", "GB/s", true, gb_per_s,
+                                  opts.confidence));
+    reader.destroy(dev);
+  }
+
+  // 3. Fixed cost of one dispatch, seen from the host
+  {
+    shader_pipeline noop;
+    noop.prepare(dev, "noop.spv", gpu.push_descriptor_supported);
+    memory_block result;
+    result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    std::vector<double> gpu_ns, wall_ns, wall_us;
+    time_dispatches(gpu, noop, {&result}, opts.dispatches, gpu_ns, wall_ns);
+    for (double ns : wall_ns)
+      wall_us.push_back(ns / 1000.0);
+    metrics.push_back(make_metric("dispatch_overhead", "us", false, wall_us,
+                                  opts.confidence));
+    noop.destroy(dev);
+  }
+  return metrics;
+}
+
+std::string baseline_path(const std::string &dir, const gpu_system &gpu) {
+  std::string id = gpu.device_uuid;
+  if (id.empty()) {
+    for (const char *c = gpu.device_properties.deviceName; *c; c++)
+      id += std::isalnum((unsigned char)*c) ? *c : '_';
+  }
+  return dir + "/" + id + "_" +
+         formatDriverVersion(gpu.device_properties.vendorID,
+                             gpu.device_properties.driverVersion) +
+         ".baseline";
+}
+
+void save_baseline(const std::string &path, const gpu_system &gpu,
+                   const std::vector<metric_result> &metrics) {
+  std::error_code ignored; // an unwritable directory fails just below
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ignored);
+  std::ofstream file(path);
+  if (!file)
+    throw std::runtime_error("cannot write baseline " + path);
+  file << "# m4_profiler regression baseline" << std::endl
+       << "# device: " << gpu.device_properties.deviceName << std::endl
+       << "# uuid: " << gpu.device_uuid << std::endl
+       << "# driver: "
+       << formatDriverVersion(gpu.device_properties.vendorID,
+                              gpu.device_properties.driverVersion)
+       << std::endl;
+  file << std::setprecision(17);
+  for (const metric_result &m : metrics)
+    file << m.name << " " << m.unit << " "
+         << (m.higher_is_better ? "higher" : "lower") << " " << m.ci.mean
+         << " " << m.ci.low << " " << m.ci.high << " " << m.ci.count << " "
+         << m.ci.level << std::endl;
+}
+
+bool load_baseline(const std::string &path,
+                   std::vector<metric_result> &metrics) {
+  std::ifstream file(path);
+  if (!file)
+    return false;
+  metrics.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    metric_result m;
+    std::string direction;
+    if (!(fields >> m.name >> m.unit >> direction >> m.ci.mean >> m.ci.low >>
+          m.ci.high >> m.ci.count >> m.ci.level))
+      throw std::runtime_error("malformed baseline line in " + path + ": " +
+                               line);
+    m.higher_is_better = direction == "higher";
+    metrics.push_back(m);
+  }
+  return true;
+}
+
+uint32_t compare_to_baseline(const std::vector<metric_result> &baseline,
+                             const std::vector<metric_result> &current,
+                             double tolerance, std::ostream &out) {
+  std::map<std::string, const metric_result *> by_name;
+  for (const metric_result &m : baseline)
+    by_name[m.name] = &m;
+
+  auto interval = [](const confidence_interval &ci) {
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(2) << ci.mean << " [" << ci.low
+      << ", " << ci.high << "]";
+    return s.str();
+  };
+
+  uint32_t regressions = 0;
+  out << std::left << std::setw(30) << "metric" << std::setw(30) << "baseline"
+      << std::setw(30) << "current" << std::setw(10) << "change"
+      << "status" << std::right << std::endl;
+  out << std::fixed << std::setprecision(2);
+  for (const metric_result &cur : current) {
+    out << std::left << std::setw(30) << cur.name + " (" + cur.unit + ")";
+    auto it = by_name.find(cur.name);
+    if (it == by_name.end()) {
+      out << std::setw(30) << "-" << std::setw(30) << interval(cur.ci)
+          << std::setw(10) << "-" << "new" << std::right << std::endl;
+      continue;
+    }
+    const metric_result &base = *it->second;
+
+    // Compare worst case against best case, with the tolerance as slack.
+    bool worse, better;
+    if (cur.higher_is_better) {
+      worse = cur.ci.high < base.ci.low * (1.0 - tolerance);
+      better = cur.ci.low > base.ci.high * (1.0 + tolerance);
+    } else {
+      worse = cur.ci.low > base.ci.high * (1.0 + tolerance);
+      better = cur.ci.high < base.ci.low * (1.0 - tolerance);
+    }
+    double change =
+        base.ci.mean != 0.0 ? (cur.ci.mean / base.ci.mean - 1.0) * 100.0 : 0.0;
+    std::ostringstream pct;
+    pct << std::fixed << std::setprecision(1) << std::showpos << change << "%";
+
+    out << std::setw(30) << interval(base.ci) << std::setw(30)
+        << interval(cur.ci) << std::setw(10) << pct.str()
+        << (worse ? "REGRESSED" : better ? "improved" : "ok") << std::right
+        << std::endl;
+    regressions += worse;
+  }
+  out << std::defaultfloat;
+  return regressions;
+}
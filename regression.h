@@ -0,0 +1,67 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "stats.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One metric of the fixed regression set, summarized over its repetitions.
+struct metric_result {
+  std::string name; // e.g. "latency_4MB", "read_bandwidth", "dispatch_overhead"
+  std::string unit; // "ns/hop", "GB/s", "us"
+  bool higher_is_better = false;
+  confidence_interval ci;
+};
+
+struct regression_options {
+  uint32_t repetitions = 10;   // samples per latency / bandwidth metric
+  uint32_t dispatches = 200;   // samples for dispatch overhead
+  double confidence = 0.95;    // level of every interval
+  double tolerance = 0.05;     // allowed relative change before failing
+};
+
+// The fixed set, always measured the same way so files stay comparable:
+//   latency_<size>     pointer chase (lat_comp.spv) at 16KB, 256KB, 4MB,
+//                      64MB and 512MB, one point per cache level or so
+//   read_bandwidth     bw_read.spv streaming a 256MB device-local buffer
+//   dispatch_overhead  host wall time of submit + fence wait of noop.spv
+std::vector<metric_result> run_regression_set(gpu_system &gpu,
+                                              const regression_options &opts);
+
+// <dir>/<device uuid>_<driver version>.baseline (the device name stands in
+// for drivers that report no UUID).
+std::string baseline_path(const std::string &dir, const gpu_system &gpu);
+
+// A plain text file: '#' header lines describing the device, then one
+// "name unit higher|lower mean low high count level" line per metric.
+void save_baseline(const std::string &path, const gpu_system &gpu,
+                   const std::vector<metric_result> &metrics);
+// false when the file does not exist; throws std::runtime_error when it
+// exists but cannot be parsed.
+bool load_baseline(const std::string &path,
+                   std::vector<metric_result> &metrics);
+
+// Prints a row per metric and returns how many regressed. A metric regresses
+// only when its whole interval is worse than the baseline's whole interval
+// stretched by the tolerance, so noise alone does not fail a run.
+uint32_t compare_to_baseline(const std::vector<metric_result> &baseline,
+                             const std::vector<metric_result> &current,
+                             double tolerance, std::ostream &out);
@@ -0,0 +1,143 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "result_writer.h"
+#include "utils.h"
+
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// JSON string body: quotes, backslashes and control characters escaped.
+std::string json_escape(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// CSV field: quoted when it holds a comma, quote or newline.
+std::string csv_field(const std::string &s) {
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"')
+      out += '"';
+    out += c;
+  }
+  return out + "\"";
+}
+
+} // namespace
+
+output_format parse_output_format(const std::string &name) {
+  if (name == "text")
+    return output_format::text;
+  if (name == "ndjson" || name == "json")
+    return output_format::ndjson;
+  if (name == "csv")
+    return output_format::csv;
+  throw std::invalid_argument("unknown output format: " + name);
+}
+
+void result_writer::create(std::ostream &out, output_format format,
+                           const run_metadata &meta) {
+  out_ = &out;
+  format_ = format;
+  metadata = meta;
+  header_written_ = false;
+}
+
+void result_writer::write(const sweep_point &point) {
+  std::ostream &out = *out_;
+  const run_metadata &m = metadata;
+
+  switch (format_) {
+  case output_format::text:
+    out << formatBytes(point.bytes) << " | Latency: " << point.ns_per_hop
+        << " ns/hop";
+    for (const counter_value &c : point.counters)
+      out << " | " << c.name << ": " << c.value
+          << (c.unit.empty() ? "" : " ") << c.unit;
+    out << std::endl;
+    return;
+
+  case output_format::ndjson:
+    out << std::setprecision(std::numeric_limits<double>::max_digits10)
+        << "{\"engine\":\"" << json_escape(m.engine) << "\",\"device\":\""
+        << json_escape(m.device_name) << "\",\"driver_version\":\""
+        << json_escape(m.driver_version)
+        << "\",\"timestamp_period\":" << m.timestamp_period
+        << ",\"memory_type\":";
+    if (m.memory_type_index < 0)
+      out << "null";
+    else
+      out << m.memory_type_index;
+    out << ",\"memory_flags\":\"" << json_escape(m.memory_flags)
+        << "\",\"layout\":\"" << json_escape(m.layout)
+        << "\",\"seed\":" << m.seed << ",\"hops\":" << m.hops
+        << ",\"repetition\":" << point.repetition
+        << ",\"count\":" << point.count << ",\"bytes\":" << point.bytes
+        << ",\"ns_per_hop\":" << point.ns_per_hop;
+    if (!point.counters.empty()) {
+      out << ",\"counters\":{";
+      for (size_t i = 0; i < point.counters.size(); i++)
+        out << (i ? "," : "") << "\"" << json_escape(point.counters[i].name)
+            << "\":" << point.counters[i].value;
+      out << "}";
+    }
+    out << "}" << std::endl;
+    return;
+
+  case output_format::csv:
+    if (!header_written_) {
+      out << "engine,device,driver_version,timestamp_period,memory_type,"
+             "memory_flags,layout,seed,hops,repetition,count,bytes,"
+             "ns_per_hop";
+      // One extra column per counter, named after the first point's
+      for (const counter_value &c : point.counters)
+        out << "," << csv_field(c.name);
+      out << std::endl;
+      header_written_ = true;
+    }
+    out << std::setprecision(std::numeric_limits<double>::max_digits10)
+        << csv_field(m.engine) << "," << csv_field(m.device_name) << ","
+        << csv_field(m.driver_version) << "," << m.timestamp_period << ",";
+    if (m.memory_type_index >= 0)
+      out << m.memory_type_index;
+    out << "," << csv_field(m.memory_flags) << "," << csv_field(m.layout)
+        << "," << m.seed << "," << m.hops << "," << point.repetition << ","
+        << point.count << "," << point.bytes << "," << point.ns_per_hop;
+    for (const counter_value &c : point.counters)
+      out << "," << c.value;
+    out << std::endl;
+    return;
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "sweep_driver.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum class output_format {
+  text,   // "64.00 KB | Latency: 53.9 ns/hop", as the tool always printed
+  ndjson, // one JSON object per line
+  csv,    // a header line, then one row per point
+};
+
+// "text", "ndjson", "csv"; throws std::invalid_argument otherwise.
+output_format parse_output_format(const std::string &name);
+
+// What a run measured with; repeated on every machine-readable row so each
+// line stands alone after grep / concatenation.
+struct run_metadata {
+  std::string engine;         // "gpu" or "cpu"
+  std::string device_name;    // deviceName, or the host CPU model
+  std::string driver_version; // formatDriverVersion, empty for the CPU
+  double timestamp_period = 0.0; // ns per GPU timestamp / CPU counter tick
+  int memory_type_index = -1;    // -1 for host memory
+  std::string memory_flags;      // formatMemoryFlags, or host page backing
+  std::string layout;            // chain_layout_name
+  uint64_t seed = 0;
+  uint32_t hops = 0;
+};
+
+// Streams sweep points in one format, flushing after each so long sweeps can
+// be tailed and piped while they run.
+class result_writer {
+public:
+  // Update between points when a field changes mid-run (e.g. the memory
+  // type a buffer landed in).
+  run_metadata metadata;
+
+  void create(std::ostream &out, output_format format,
+              const run_metadata &meta);
+  void write(const sweep_point &point);
+
+private:
+  std::ostream *out_ = nullptr;
+  output_format format_ = output_format::text;
+  bool header_written_ = false;
+};
@@ -17,52 +17,85 @@
  */
 
 #include "shader_pipeline.h"
+#include "stats.h"
 #include "utils.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 void shader_pipeline::prepare(VkDevice logical_device,
-                              const std::string &shader_path) {
+                              const std::string &shader_path,
+                              bool push_descriptors) {
+  // 0. Load the SPIR-V first: the kernel itself tells us what it binds.
+  auto shader_code = readBinaryFile(shader_path);
+  if (shader_code.empty()) {
+    throw std::runtime_error(
+        "Shader_pipeline: SPIR-V file is empty or missing: " + shader_path);
+  }
+  bindings = reflect_shader_bindings(shader_code);
+  push_constant_size = reflect_push_constant_size(shader_code);
+  for (const shader_binding &b : bindings) {
+    if (b.set != 0)
+      throw std::runtime_error(
+          "Shader_pipeline: only descriptor set 0 is supported: " +
+          shader_path);
+  }
+
   // 1. Describe the "Blueprint" (Descriptor Set Layout).
   // This is the buffer to slot-binding step. Slots are
   // how the shader accesses buffers.
   // Buffers get bound to a slot.
-  // We expect two buffers: nodes bound at slot 0, and result bound at slot 1.
+  // For lat_comp that is nodes at slot 0 and result at slot 1, but the
+  // list comes from reflection so other kernels need no changes here.
   // -  This is called a descriptor-set.
-  VkDescriptorSetLayoutBinding bindings[2] = {};
-  for (int i = 0; i < 2; i++) {
-    bindings[i].binding = i;
-    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[i].descriptorCount = 1;
-    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  std::vector<VkDescriptorSetLayoutBinding> layout_bindings(bindings.size());
+  for (size_t i = 0; i < bindings.size(); i++) {
+    layout_bindings[i].binding = bindings[i].binding;
+    layout_bindings[i].descriptorType = bindings[i].descriptor_type;
+    layout_bindings[i].descriptorCount = bindings[i].descriptor_count;
+    layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
   }
 
   // Enclose descriptor-set in a layout, which indicates for ex., how many
-  // bindings are in the set.
+  // bindings are in the set. A push-descriptor layout is never allocated
+  // from a pool; its contents are written into the command buffer instead.
+  use_push_descriptors = push_descriptors;
   VkDescriptorSetLayoutCreateInfo layout_info{
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-  layout_info.bindingCount = 2;
-  layout_info.pBindings = bindings;
+  if (use_push_descriptors)
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+  layout_info.bindingCount = (uint32_t)layout_bindings.size();
+  layout_info.pBindings = layout_bindings.data();
   VK_CHECK(vkCreateDescriptorSetLayout(logical_device, &layout_info, nullptr,
                                        &descriptor_layout));
 
+  if (use_push_descriptors) {
+    push_descriptor_fn_ = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(
+        vkGetDeviceProcAddr(logical_device, "vkCmdPushDescriptorSetKHR"));
+    if (push_descriptor_fn_ == nullptr)
+      throw std::runtime_error(
+          "Shader_pipeline: vkCmdPushDescriptorSetKHR not available");
+  } else {
+    descriptors.create(logical_device, descriptor_layout, bindings);
+  }
+
   // 2. Create the Pipeline Layout (The connection between shader and
-  // descriptor-set)
+  // descriptor-set), plus the push constant range when the kernel has one
   VkPipelineLayoutCreateInfo pipe_layout_info{
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
   pipe_layout_info.setLayoutCount = 1;
   pipe_layout_info.pSetLayouts = &descriptor_layout;
+  VkPushConstantRange push_range{VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                 push_constant_size};
+  if (push_constant_size > 0) {
+    pipe_layout_info.pushConstantRangeCount = 1;
+    pipe_layout_info.pPushConstantRanges = &push_range;
+  }
   // Now add the pipeline-layout to logical_device
   VK_CHECK(vkCreatePipelineLayout(logical_device, &pipe_layout_info, nullptr,
                                   &pipeline_layout));
 
-  // 3. Load the SPIR-V
-  auto shader_code = readBinaryFile(shader_path);
-  if (shader_code.empty()) {
-    throw std::runtime_error(
-        "Shader_pipeline: SPIR-V file is empty or missing: " + shader_path);
-  }
-
-  // The binary is added to a Shader-module.
+  // 3. The binary is added to a Shader-module.
   VkShaderModuleCreateInfo mod_info{
       VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
   mod_info.codeSize = shader_code.size();
@@ -81,6 +114,21 @@ void shader_pipeline::prepare(VkDevice logical_device,
   pipe_info.stage.module = shader_module;
   pipe_info.stage.pName = "main"; // Entry point in your .comp shader
 
+  std::vector<VkSpecializationMapEntry> spec_entries(
+      specialization_constants.size());
+  for (uint32_t i = 0; i < spec_entries.size(); i++) {
+    spec_entries[i].constantID = i;
+    spec_entries[i].offset = i * sizeof(uint32_t);
+    spec_entries[i].size = sizeof(uint32_t);
+  }
+  VkSpecializationInfo spec_info{};
+  spec_info.mapEntryCount = (uint32_t)spec_entries.size();
+  spec_info.pMapEntries = spec_entries.data();
+  spec_info.dataSize = specialization_constants.size() * sizeof(uint32_t);
+  spec_info.pData = specialization_constants.data();
+  if (!spec_entries.empty())
+    pipe_info.stage.pSpecializationInfo = &spec_info;
+
   // On M4 Max, this will trigger the MoltenVK/Metal compilation
   VK_CHECK(vkCreateComputePipelines(logical_device, VK_NULL_HANDLE, 1,
                                     &pipe_info, nullptr, &pipeline_handle));
@@ -91,60 +139,28 @@ void shader_pipeline::prepare(VkDevice logical_device,
 
 void shader_pipeline::bind_blocks(VkDevice logical_device,
                                   const std::vector<memory_block *> &blocks) {
-  // 1. Create a Pool to hold our Descriptor Set
-  VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                                 (uint32_t)blocks.size()};
-
-  VkDescriptorPoolCreateInfo pool_info{
-      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-  pool_info.maxSets = 1;
-  pool_info.poolSizeCount = 1;
-  pool_info.pPoolSizes = &pool_size;
-
-  VK_CHECK(vkCreateDescriptorPool(logical_device, &pool_info, nullptr,
-                                  &descriptor_pool));
-
-  // 2. Allocate the set from the pool using the layout we made in 'prepare'
-  VkDescriptorSetAllocateInfo alloc_info{
-      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-  alloc_info.descriptorPool = descriptor_pool;
-  alloc_info.descriptorSetCount = 1;
-  alloc_info.pSetLayouts = &descriptor_layout;
+  bind_resources(logical_device, std::vector<descriptor_resource>(
+                                     blocks.begin(), blocks.end()));
+}
 
-  VK_CHECK(
-      vkAllocateDescriptorSets(logical_device, &alloc_info, &descriptor_set));
-
-  // 3. Connect the physical memory blocks to the shader bindings
-  std::vector<VkDescriptorBufferInfo> buffer_infos;
-  std::vector<VkWriteDescriptorSet> writes;
-
-  // CRITICAL: Prevent reallocations so pointers remain valid
-  buffer_infos.reserve(blocks.size());
-  writes.reserve(blocks.size());
-
-  for (uint32_t i = 0; i < blocks.size(); i++) {
-    VkDescriptorBufferInfo b_info{};
-    b_info.buffer = blocks[i]->logical_memory_block_handle;
-    b_info.offset = 0;
-    b_info.range = VK_WHOLE_SIZE;
-    buffer_infos.push_back(b_info);
-
-    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    write.dstSet = descriptor_set;
-    write.dstBinding = i;
-    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    write.descriptorCount = 1;
-    // Now this pointer is safe because we reserved space!
-    write.pBufferInfo = &buffer_infos.back();
-    writes.push_back(write);
+void shader_pipeline::bind_resources(
+    VkDevice /*logical_device*/,
+    const std::vector<descriptor_resource> &resources) {
+  // With push descriptors there is nothing to allocate: remember the
+  // resources and write them into the command buffer when run() records it.
+  if (use_push_descriptors) {
+    pushed_resources_ = resources;
+    return;
   }
 
-  vkUpdateDescriptorSets(logical_device, (uint32_t)writes.size(), writes.data(),
-                         0, nullptr);
+  // Otherwise take a set from the allocator; binding the same resources
+  // again (repeated runs over one buffer) reuses the set it handed out before.
+  descriptor_set = descriptors.acquire(resources);
 }
 
 void shader_pipeline::run(VkDevice logical_device, VkQueue queue,
-                          uint32_t queue_idx, timer &stopwatch) {
+                          uint32_t queue_idx, timer &stopwatch,
+                          dispatch_counters *counters) {
   // 1. Create a temporary Command Pool for this run
   VkCommandPool pool;
   VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
@@ -164,33 +180,83 @@ void shader_pipeline::run(VkDevice logical_device, VkQueue queue,
   VkCommandBufferBeginInfo begin_info{
       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
   vkBeginCommandBuffer(cb, &begin_info);
+  record(cb, stopwatch, counters);
+  vkEndCommandBuffer(cb);
+
+  // 4. Submit to the M4 Max and wait on a fence for just this batch, rather
+  // than idling the whole queue
+  VkFence done;
+  VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VK_CHECK(vkCreateFence(logical_device, &fence_info, nullptr, &done));
+
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cb;
+
+  VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, done));
+  VK_CHECK(vkWaitForFences(logical_device, 1, &done, VK_TRUE, UINT64_MAX));
+  vkDestroyFence(logical_device, done, nullptr);
+
+  // 5. Cleanup temporary command objects
+  vkDestroyCommandPool(logical_device, pool, nullptr);
+}
+
+double
+shader_pipeline::median_run_ns(VkDevice logical_device, VkQueue queue,
+                               uint32_t queue_idx, timer &stopwatch,
+                               uint32_t repetitions,
+                               const std::function<void()> &before_each) {
+  std::vector<double> samples;
+  for (uint32_t r = 0; r <= std::max<uint32_t>(repetitions, 1); r++) {
+    if (before_each)
+      before_each();
+    run(logical_device, queue, queue_idx, stopwatch);
+    if (r > 0)
+      samples.push_back(stopwatch.get_nanoseconds(logical_device));
+  }
+  return summarize(samples).p50;
+}
+
+void shader_pipeline::record(VkCommandBuffer cb, timer &stopwatch,
+                             dispatch_counters *counters) {
+  // Counters bracket the stopwatch, so the timed range is the same with or
+  // without them
+  if (counters)
+    counters->begin(cb);
 
   // Start the stopwatch
   stopwatch.start(cb);
 
   // Bind the tools and the data
   vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
-  vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout,
-                          0, 1, &descriptor_set, 0, nullptr);
+  if (use_push_descriptors) {
+    descriptor_write_storage storage;
+    std::vector<VkWriteDescriptorSet> writes;
+    make_descriptor_writes(bindings, pushed_resources_, VK_NULL_HANDLE,
+                           storage, writes);
+    push_descriptor_fn_(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0,
+                        (uint32_t)writes.size(), writes.data());
+  } else {
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+  }
+
+  if (push_constant_size > 0) {
+    if (push_constants.size() < push_constant_size)
+      throw std::runtime_error("Shader_pipeline: kernel takes " +
+                               std::to_string(push_constant_size) +
+                               " bytes of push constants");
+    vkCmdPushConstants(cb, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       push_constant_size, push_constants.data());
+  }
 
   // Go! (Dispatch 1 thread for latency)
-  vkCmdDispatch(cb, 1, 1, 1);
+  vkCmdDispatch(cb, group_count_x, 1, 1);
 
   // Stop the stopwatch
   stopwatch.stop(cb);
-
-  vkEndCommandBuffer(cb);
-
-  // 4. Submit to the M4 Max and wait
-  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &cb;
-
-  VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
-  vkQueueWaitIdle(queue);
-
-  // 5. Cleanup temporary command objects
-  vkDestroyCommandPool(logical_device, pool, nullptr);
+  if (counters)
+    counters->end(cb);
 }
 
 void shader_pipeline::destroy(VkDevice logical_device) {
@@ -200,14 +266,15 @@ void shader_pipeline::destroy(VkDevice logical_device) {
     vkDestroyPipelineLayout(logical_device, pipeline_layout, nullptr);
   if (descriptor_layout != VK_NULL_HANDLE)
     vkDestroyDescriptorSetLayout(logical_device, descriptor_layout, nullptr);
-  if (descriptor_pool != VK_NULL_HANDLE)
-    vkDestroyDescriptorPool(logical_device, descriptor_pool, nullptr);
+  descriptors.destroy(logical_device);
 
   // Reset handles
   pipeline_handle = VK_NULL_HANDLE;
   pipeline_layout = VK_NULL_HANDLE;
   descriptor_layout = VK_NULL_HANDLE;
-  descriptor_pool = VK_NULL_HANDLE;
   descriptor_set = VK_NULL_HANDLE;
+  push_descriptor_fn_ = nullptr;
+  pushed_resources_.clear();
+  push_constant_size = 0;
 }
 
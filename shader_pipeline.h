@@ -1,6 +1,10 @@
 #pragma once
+#include "descriptor_allocator.h"
+#include "dispatch_counters.h"
 #include "memory_block.h"
+#include "spirv_reflect.h"
 #include "timer.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -32,20 +36,64 @@ public:
   VkDescriptorSetLayout descriptor_layout = VK_NULL_HANDLE;
   VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
   VkPipeline pipeline_handle = VK_NULL_HANDLE;
-  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  // Set picked by the last bind_blocks() (unused with push descriptors)
   VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
 
-  // 1. Loads the shader and sets up the "blueprint" for the GPU
-  void prepare(VkDevice logical_device, const std::string &shader_path);
+  // Resource slots read out of the kernel's SPIR-V by prepare()
+  std::vector<shader_binding> bindings;
+  // Sets are cached per group of blocks rather than created per bind
+  descriptor_allocator descriptors;
+  // true when descriptors are pushed into the command buffer at run() time
+  bool use_push_descriptors = false;
+  // 32-bit specialization constants applied by prepare(): entry i overrides
+  // constant_id i (e.g. HOPS in lat_comp.comp). Set before prepare().
+  std::vector<uint32_t> specialization_constants;
+  // Workgroups record() dispatches along x (the latency kernels use one).
+  uint32_t group_count_x = 1;
+  // Size of the kernel's push constant block, read out of its SPIR-V by
+  // prepare() (0 = none), and the bytes record() pushes into it. Set
+  // push_constants after prepare(); it must hold push_constant_size bytes.
+  uint32_t push_constant_size = 0;
+  std::vector<uint8_t> push_constants;
 
-  // 2. Plumbs the specific memory_blocks into the shader bindings
+  // 1. Loads the shader and sets up the "blueprint" for the GPU.
+  // Pass push_descriptors = true only when the device enabled
+  // VK_KHR_push_descriptor (see gpu_system::push_descriptor_supported).
+  void prepare(VkDevice logical_device, const std::string &shader_path,
+               bool push_descriptors = false);
+
+  // 2. Plumbs the specific memory_blocks into the shader bindings, in
+  // binding order. Re-binding blocks seen before is a cache lookup.
   void bind_blocks(VkDevice logical_device,
                    const std::vector<memory_block *> &blocks);
 
-  // 3. Tells the GPU to execute the task and records the time
+  // 2b. The same for kernels that also read texel buffers or images.
+  void bind_resources(VkDevice logical_device,
+                      const std::vector<descriptor_resource> &resources);
+
+  // 3. Tells the GPU to execute the task and records the time (and the
+  // counters, when given; read them with counters->results())
   void run(VkDevice logical_device, VkQueue queue, uint32_t queue_idx,
-           timer &stopwatch);
+           timer &stopwatch, dispatch_counters *counters = nullptr);
+
+  // 3a. run() once as a warm-up and then `repetitions` times (at least one),
+  // returning the median GPU time in ns. before_each, if given, runs on the
+  // host ahead of every run, e.g. to reset what the kernel consumes.
+  double median_run_ns(VkDevice logical_device, VkQueue queue,
+                       uint32_t queue_idx, timer &stopwatch,
+                       uint32_t repetitions,
+                       const std::function<void()> &before_each = {});
+
+  // 3b. Records the timed dispatch into a command buffer the caller owns and
+  // submits; run() is this plus a throwaway pool and a fence wait. With
+  // counters, this must be the first thing recorded into cb.
+  void record(VkCommandBuffer cb, timer &stopwatch,
+              dispatch_counters *counters = nullptr);
 
   // 4. Tears down the pipeline logic
   void destroy(VkDevice logical_device);
+
+private:
+  PFN_vkCmdPushDescriptorSetKHR push_descriptor_fn_ = nullptr;
+  std::vector<descriptor_resource> pushed_resources_; // to push in run()
 };
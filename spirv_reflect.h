@@ -0,0 +1,43 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One resource slot declared by a kernel, e.g.
+//   layout(set = 0, binding = 1) buffer ResultBuffer { ... };
+// becomes {set 0, binding 1, STORAGE_BUFFER, count 1}.
+struct shader_binding {
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  VkDescriptorType descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  uint32_t descriptor_count = 1; // > 1 for arrays of resources
+};
+
+// Reads the descriptor bindings straight out of a SPIR-V binary so the
+// pipeline layout follows the kernel instead of being written out by hand.
+// Only the handful of opcodes that describe resources are decoded; the
+// result is sorted by (set, binding). Throws std::runtime_error on a
+// malformed module.
+std::vector<shader_binding>
+reflect_shader_bindings(const std::vector<uint8_t> &spirv);
+
+// Size in bytes of the kernel's push constant block (the end of its last
+// member, from the Offset and ArrayStride decorations), or 0 without one.
+uint32_t reflect_push_constant_size(const std::vector<uint8_t> &spirv);
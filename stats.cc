@@ -0,0 +1,180 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Nearest-rank percentile of already sorted samples.
+double percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+  rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+  return sorted[rank - 1];
+}
+
+// Regularized incomplete beta I_x(a, b) by Lentz's continued fraction.
+double incomplete_beta(double x, double a, double b) {
+  if (x <= 0.0)
+    return 0.0;
+  if (x >= 1.0)
+    return 1.0;
+  // The fraction converges fast only below the mean; use symmetry above it.
+  if (x > (a + 1.0) / (a + b + 2.0))
+    return 1.0 - incomplete_beta(1.0 - x, b, a);
+
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+                          std::lgamma(b) + a * std::log(x) +
+                          b * std::log(1.0 - x)) /
+                 a;
+  const double tiny = 1e-300;
+  double c = 1.0, d = 1.0 - (a + b) * x / (a + 1.0);
+  d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+  double f = d;
+  for (int m = 1; m < 300; m++) {
+    for (int step = 0; step < 2; step++) {
+      double num = step == 0
+                       ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m))
+                       : -(a + m) * (a + b + m) * x /
+                             ((a + 2 * m) * (a + 2 * m + 1));
+      d = 1.0 + num * d;
+      d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+      c = 1.0 + num / c;
+      if (std::fabs(c) < tiny)
+        c = tiny;
+      f *= c * d;
+    }
+    if (std::fabs(c * d - 1.0) < 1e-12)
+      break;
+  }
+  return front * f;
+}
+
+// P(|T| <= t) for Student's t with df degrees of freedom.
+double student_t_central(double t, double df) {
+  return 1.0 - incomplete_beta(df / (df + t * t), df / 2.0, 0.5);
+}
+
+} // namespace
+
+double student_t_critical(double level, double df) {
+  // Bisection: the central probability rises monotonically with t.
+  double lo = 0.0, hi = 1.0;
+  while (student_t_central(hi, df) < level)
+    hi *= 2.0;
+  for (int i = 0; i < 100; i++) {
+    double mid = 0.5 * (lo + hi);
+    if (student_t_central(mid, df) < level)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return 0.5 * (lo + hi);
+}
+
+confidence_interval mean_confidence_interval(const std::vector<double> &samples,
+                                             double level) {
+  confidence_interval ci;
+  ci.level = level;
+  ci.count = samples.size();
+  if (samples.empty())
+    return ci;
+
+  distribution d = summarize(samples);
+  ci.mean = ci.low = ci.high = d.mean;
+  if (d.count < 2)
+    return ci;
+  double half = student_t_critical(level, (double)(d.count - 1)) * d.stddev /
+                std::sqrt((double)d.count);
+  ci.low = d.mean - half;
+  ci.high = d.mean + half;
+  return ci;
+}
+
+distribution summarize(std::vector<double> samples) {
+  distribution d;
+  if (samples.empty())
+    return d;
+
+  std::sort(samples.begin(), samples.end());
+  d.count = samples.size();
+  d.min = samples.front();
+  d.max = samples.back();
+
+  double sum = 0.0;
+  for (double s : samples)
+    sum += s;
+  d.mean = sum / (double)d.count;
+
+  double squares = 0.0;
+  for (double s : samples)
+    squares += (s - d.mean) * (s - d.mean);
+  d.stddev = d.count > 1 ? std::sqrt(squares / (double)(d.count - 1)) : 0.0;
+
+  d.p50 = percentile(samples, 50.0);
+  d.p90 = percentile(samples, 90.0);
+  d.p99 = percentile(samples, 99.0);
+  d.p999 = percentile(samples, 99.9);
+  return d;
+}
+
+std::string format_distribution(const distribution &d, const char *unit) {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1) << "min " << d.min << unit
+     << " | p50 " << d.p50 << unit << " | p90 " << d.p90 << unit << " | p99 "
+     << d.p99 << unit << " | p99.9 " << d.p999 << unit << " | max " << d.max
+     << unit;
+  return ss.str();
+}
+
+#ifdef STATS_UNIT_TEST
+
+// Checks the t critical values against the published tables and a known
+// interval. No Vulkan needed:
+//
+//   clang++ -std=c++17 -DSTATS_UNIT_TEST stats.cc -o stats_test
+//   ./stats_test
+#include <cassert>
+#include <iostream>
+
+int main() {
+  auto near = [](double a, double b) { return std::fabs(a - b) < 1e-3; };
+  assert(near(student_t_critical(0.95, 1), 12.706));
+  assert(near(student_t_critical(0.95, 4), 2.776));
+  assert(near(student_t_critical(0.99, 10), 3.169));
+  assert(near(student_t_critical(0.95, 1000), 1.962));
+
+  // mean 3, sample stddev sqrt(2.5), t(0.95, 4) = 2.776
+  confidence_interval ci = mean_confidence_interval({1, 2, 3, 4, 5});
+  assert(near(ci.mean, 3.0));
+  assert(near(ci.high - ci.mean, 2.776 * std::sqrt(2.5) / std::sqrt(5.0)));
+  assert(near(ci.mean - ci.low, ci.high - ci.mean));
+
+  confidence_interval one = mean_confidence_interval({7});
+  assert(one.low == 7 && one.high == 7);
+
+  distribution d = summarize({5, 1, 4, 2, 3});
+  assert(d.min == 1 && d.max == 5 && d.p50 == 3);
+
+  std::cout << "stats tests passed" << std::endl;
+  return 0;
+}
+
+#endif // STATS_UNIT_TEST
@@ -0,0 +1,52 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The shape of a set of samples (latencies, bandwidths...), in the units the
+// samples were given in.
+struct distribution {
+  size_t count = 0;
+  double min = 0.0, max = 0.0;
+  double mean = 0.0, stddev = 0.0;
+  double p50 = 0.0, p90 = 0.0, p99 = 0.0, p999 = 0.0;
+};
+
+// Sorts a copy of `samples` and reads off the usual percentiles
+// (nearest-rank). An empty input gives an all-zero distribution.
+distribution summarize(std::vector<double> samples);
+
+// Two-sided Student-t interval for the mean of the samples.
+struct confidence_interval {
+  double mean = 0.0, low = 0.0, high = 0.0;
+  double level = 0.95;
+  size_t count = 0;
+};
+
+// Fewer than two samples give a zero-width interval at the mean.
+confidence_interval mean_confidence_interval(const std::vector<double> &samples,
+                                             double level = 0.95);
+
+// Two-sided Student-t critical value: P(|T| <= t) = level with `df` degrees
+// of freedom.
+double student_t_critical(double level, double df);
+
+// "min 1.2 | p50 3.4 | p90 ... | max 9.9" with the given unit suffix.
+std::string format_distribution(const distribution &d, const char *unit);
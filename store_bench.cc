@@ -0,0 +1,205 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "store_bench.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "sweep_driver.h"
+#include "timer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+// Word offsets in visibility_pingpong.comp's mailbox.
+constexpr size_t rounds_word = 128;
+constexpr size_t status_word = 129;
+constexpr size_t stale_word = 130;
+constexpr VkDeviceSize mailbox_bytes = 1024;
+
+// Timed dispatches per point, after one warm-up; the median is reported.
+constexpr uint32_t repetitions = 3;
+
+} // namespace
+
+std::vector<store_load_point>
+run_store_load_chains(gpu_system &gpu, const std::vector<uint32_t> &counts,
+                      uint32_t hops, uint64_t seed) {
+  VkDevice dev = gpu.logical_device_handle;
+  const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  // 1. One pipeline per mode, all over the same chain
+  shader_pipeline modes[3];
+  for (uint32_t m = 0; m < 3; m++) {
+    modes[m].specialization_constants = {hops, m};
+    modes[m].prepare(dev, "store_load.spv", gpu.push_descriptor_supported);
+  }
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+  memory_block result;
+  result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, flags);
+
+  // 2. Every size through every mode
+  std::vector<store_load_point> points;
+  std::vector<uint32_t> scratch;
+  for (uint32_t count : counts) {
+    memory_block nodes;
+    nodes.create(dev, gpu.physical_device_handle,
+                 VkDeviceSize(count) * sizeof(uint32_t),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, flags);
+    upload_shuffled_chain(nodes, count, scratch, chain_layout::random,
+                          seed + count);
+
+    store_load_point point;
+    point.count = count;
+    point.bytes = VkDeviceSize(count) * sizeof(uint32_t);
+    double *out[3] = {&point.load_ns, &point.load_store_ns, &point.raw_ns};
+    for (uint32_t m = 0; m < 3; m++) {
+      modes[m].bind_blocks(dev, {&nodes, &result});
+      *out[m] = modes[m].median_run_ns(dev, gpu.compute_queue_handle,
+                                       gpu.compute_queue_family_index,
+                                       stopwatch, repetitions) /
+                hops;
+    }
+    points.push_back(point);
+  }
+
+  for (shader_pipeline &pipeline : modes)
+    pipeline.destroy(dev);
+  stopwatch.destroy(dev);
+  return points;
+}
+
+std::vector<store_rate_point>
+run_store_throughput(gpu_system &gpu, const std::vector<uint64_t> &sizes,
+                     uint32_t line_bytes) {
+  VkDevice dev = gpu.logical_device_handle;
+  const uint32_t passes = 4;
+  uint32_t line_words = std::max<uint32_t>(line_bytes / 4, 4);
+  std::vector<uint32_t> patterns = {1, 4, line_words / 2, line_words};
+
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+  std::vector<store_rate_point> points;
+  for (uint64_t size : sizes) {
+    // Whole lines only
+    VkDeviceSize bytes = size / (line_words * 4) * (line_words * 4);
+    if (bytes == 0)
+      continue;
+    memory_block dst;
+    dst.create(dev, gpu.physical_device_handle, bytes,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    for (uint32_t words : patterns) {
+      shader_pipeline writer;
+      writer.specialization_constants = {words, line_words, passes};
+      writer.group_count_x = std::min<uint32_t>(
+          1024, gpu.device_properties.limits.maxComputeWorkGroupCount[0]);
+      writer.prepare(dev, "store_rate.spv", gpu.push_descriptor_supported);
+      writer.bind_blocks(dev, {&dst});
+      double ns = writer.median_run_ns(dev, gpu.compute_queue_handle,
+                                       gpu.compute_queue_family_index,
+                                       stopwatch, repetitions);
+      writer.destroy(dev);
+
+      double lines = (double)(bytes / (line_words * 4)) * passes;
+      store_rate_point point;
+      point.bytes = bytes;
+      point.line_bytes = line_words * 4;
+      point.bytes_per_line = words * 4;
+      point.stored_gb_per_s = lines * words * 4 / ns;
+      point.line_gb_per_s = lines * line_words * 4 / ns;
+      points.push_back(point);
+    }
+  }
+  stopwatch.destroy(dev);
+  return points;
+}
+
+visibility_result run_visibility_pingpong(gpu_system &gpu, uint32_t rounds) {
+  VkDevice dev = gpu.logical_device_handle;
+  visibility_result result;
+  result.rounds = rounds;
+
+  // 1. The mailbox, cleared, with the round count for the kernel
+  memory_block mailbox;
+  mailbox.create(dev, gpu.physical_device_handle, mailbox_bytes,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::vector<uint32_t> words(mailbox_bytes / sizeof(uint32_t), 0);
+  words[rounds_word] = rounds;
+  mailbox.write(words.data(), mailbox_bytes);
+
+  // 2. Two workgroups, one dispatch
+  shader_pipeline pingpong;
+  pingpong.group_count_x = 2;
+  pingpong.prepare(dev, "visibility_pingpong.spv",
+                   gpu.push_descriptor_supported);
+  pingpong.bind_blocks(dev, {&mailbox});
+  timer stopwatch;
+  stopwatch.create(dev, gpu.physical_device_handle);
+  pingpong.run(dev, gpu.compute_queue_handle, gpu.compute_queue_family_index,
+               stopwatch);
+  double ns = stopwatch.get_nanoseconds(dev);
+  stopwatch.destroy(dev);
+  pingpong.destroy(dev);
+
+  // 3. What the kernel reported
+  const uint32_t *box =
+      reinterpret_cast<const uint32_t *>(mailbox.map(VK_NULL_HANDLE));
+  if (box[status_word] != 0)
+    result.error = "a workgroup gave up waiting (not resident together?)";
+  result.stale_payloads = box[stale_word];
+  mailbox.unmap(VK_NULL_HANDLE);
+  result.one_way_ns = ns / (2.0 * std::max<uint32_t>(rounds, 1));
+  return result;
+}
+
+void print_store_report(const std::vector<store_load_point> &chains,
+                        const std::vector<store_rate_point> &rates,
+                        const visibility_result &visibility,
+                        std::ostream &out) {
+  out << std::fixed << std::setprecision(2);
+  out << "Store / reload chase (ns/hop)" << std::endl;
+  for (const store_load_point &p : chains)
+    out << formatBytes(p.bytes) << " | volatile load " << p.load_ns
+        << " | load+store " << p.load_store_ns << " | store->load " << p.raw_ns
+        << std::endl;
+
+  out << "Store throughput" << std::endl;
+  for (const store_rate_point &p : rates)
+    out << formatBytes(p.bytes) << " | " << p.bytes_per_line << " of "
+        << p.line_bytes << " bytes per line | " << p.stored_gb_per_s
+        << " GB/s stored | " << p.line_gb_per_s << " GB/s of lines"
+        << std::endl;
+
+  out << "Cross-workgroup visibility" << std::endl;
+  if (!visibility.error.empty())
+    out << "not measured: " << visibility.error << std::endl;
+  else
+    out << visibility.rounds << " round trips | " << visibility.one_way_ns
+        << " ns one way | " << visibility.stale_payloads
+        << " stale payloads" << std::endl;
+  out << std::defaultfloat;
+}
@@ -0,0 +1,74 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include "utils.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// The chase with stores in the loop (store_load.comp), per chain length.
+struct store_load_point {
+  uint32_t count = 0;
+  VkDeviceSize bytes = 0;
+  double load_ns = 0.0;       // ns/hop, loads only (coherent volatile)
+  double load_store_ns = 0.0; // ns/hop, each node stored back
+  double raw_ns = 0.0;        // ns/hop, each node stored and read back
+};
+
+// Store throughput over one buffer size and write pattern
+// (store_rate.comp).
+struct store_rate_point {
+  VkDeviceSize bytes = 0;
+  uint32_t line_bytes = 0;
+  uint32_t bytes_per_line = 0; // written at the start of each line
+  double stored_gb_per_s = 0.0; // bytes the kernel wrote
+  double line_gb_per_s = 0.0;   // whole lines touched
+};
+
+// Message round trips between two workgroups (visibility_pingpong.comp).
+struct visibility_result {
+  uint32_t rounds = 0;
+  double one_way_ns = 0.0; // dispatch time / (2 * rounds)
+  uint32_t stale_payloads = 0;
+  std::string error; // e.g. the workgroups never ran side by side
+};
+
+// Each chain (size N built from seed + N) chased three times: loads, loads
+// plus a store back, loads plus a store and a dependent reload.
+std::vector<store_load_point>
+run_store_load_chains(gpu_system &gpu, const std::vector<uint32_t> &counts,
+                      uint32_t hops = 1000000, uint64_t seed = random_seed());
+
+// For each buffer size, stores of 4 bytes, 16 bytes, half a line and the
+// full line at the start of every line_bytes line.
+std::vector<store_rate_point>
+run_store_throughput(gpu_system &gpu, const std::vector<uint64_t> &sizes,
+                     uint32_t line_bytes = 128);
+
+// One dispatch of two single-invocation workgroups passing `rounds`
+// messages each way through release / acquire barriers.
+visibility_result run_visibility_pingpong(gpu_system &gpu,
+                                          uint32_t rounds = 10000);
+
+void print_store_report(const std::vector<store_load_point> &chains,
+                        const std::vector<store_rate_point> &rates,
+                        const visibility_result &visibility,
+                        std::ostream &out);
@@ -0,0 +1,231 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "submit_bench.h"
+#include "memory_block.h"
+#include "shader_pipeline.h"
+#include "stats.h"
+#include "utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// Runs body(t) for t < threads on that many threads, released together once
+// all exist, and returns the wall time from release to the last one done.
+double run_together(uint32_t threads,
+                    const std::function<void(uint32_t)> &body) {
+  std::atomic<uint32_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++)
+    workers.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire))
+        std::this_thread::yield();
+      body(t);
+    });
+  while (ready.load() < threads)
+    std::this_thread::yield();
+  clock_type::time_point start = clock_type::now();
+  go.store(true, std::memory_order_release);
+  for (std::thread &worker : workers)
+    worker.join();
+  return seconds_since(start);
+}
+
+// What one host thread owns: its pool and the buffers it records.
+struct thread_work {
+  VkCommandPool pool = VK_NULL_HANDLE;
+  std::vector<VkCommandBuffer> buffers;
+};
+
+// `count` dispatches, each with its own binds, as a renderer's draw loop
+// would issue them.
+void record_dispatches(VkCommandBuffer cb, const shader_pipeline &noop,
+                       uint32_t count, bool secondary) {
+  VkCommandBufferInheritanceInfo inheritance{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (secondary)
+    begin_info.pInheritanceInfo = &inheritance;
+  vkBeginCommandBuffer(cb, &begin_info);
+  for (uint32_t d = 0; d < count; d++) {
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, noop.pipeline_handle);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            noop.pipeline_layout, 0, 1, &noop.descriptor_set,
+                            0, nullptr);
+    vkCmdDispatch(cb, 1, 1, 1);
+  }
+  vkEndCommandBuffer(cb);
+}
+
+} // namespace
+
+const char *submit_path_name(submit_path path) {
+  return path == submit_path::shared_queue ? "shared" : "secondary";
+}
+
+std::vector<recording_point>
+run_recording_scaling(gpu_system &gpu, const recording_options &opts) {
+  VkDevice dev = gpu.logical_device_handle;
+  VkQueue queue = gpu.compute_queue_handle;
+
+  // 1. One kernel and one descriptor set, shared read-only by every thread
+  // (so no push descriptors: each record would rebuild the writes)
+  shader_pipeline noop;
+  noop.prepare(dev, "noop.spv", false);
+  memory_block result;
+  result.create(dev, gpu.physical_device_handle, sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  noop.bind_blocks(dev, {&result});
+
+  VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+  VkCommandPool merge_pool;
+  VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &merge_pool));
+  VkCommandBuffer primary;
+  VkCommandBufferAllocateInfo primary_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  primary_info.commandPool = merge_pool;
+  primary_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  primary_info.commandBufferCount = 1;
+  VK_CHECK(vkAllocateCommandBuffers(dev, &primary_info, &primary));
+
+  std::vector<recording_point> points;
+  for (submit_path path :
+       {submit_path::shared_queue, submit_path::secondary_merge}) {
+    bool secondary = path == submit_path::secondary_merge;
+    for (uint32_t threads : opts.thread_counts) {
+      // 2. A pool per thread, as the driver expects for parallel recording
+      std::vector<thread_work> work(threads);
+      for (thread_work &w : work) {
+        VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &w.pool));
+        w.buffers.resize(opts.buffers_per_thread);
+        VkCommandBufferAllocateInfo cb_info{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        cb_info.commandPool = w.pool;
+        cb_info.level = secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                                  : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cb_info.commandBufferCount = opts.buffers_per_thread;
+        VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, w.buffers.data()));
+      }
+
+      std::vector<double> record_s, submit_s, wait_s;
+      for (uint32_t rep = 0; rep < opts.repetitions; rep++) {
+        for (thread_work &w : work)
+          VK_CHECK(vkResetCommandPool(dev, w.pool, 0));
+
+        // 3. Every thread records its buffers at once
+        record_s.push_back(run_together(threads, [&](uint32_t t) {
+          for (VkCommandBuffer cb : work[t].buffers)
+            record_dispatches(cb, noop, opts.dispatches_per_buffer, secondary);
+        }));
+
+        // 4. Get everything onto the queue
+        if (!secondary) {
+          std::mutex queue_mutex;
+          std::atomic<uint64_t> waited_ns{0};
+          submit_s.push_back(run_together(threads, [&](uint32_t t) {
+            std::chrono::nanoseconds waited{0};
+            for (VkCommandBuffer cb : work[t].buffers) {
+              VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+              submit_info.commandBufferCount = 1;
+              submit_info.pCommandBuffers = &cb;
+              clock_type::time_point asked = clock_type::now();
+              std::lock_guard<std::mutex> guard(queue_mutex);
+              waited += clock_type::now() - asked;
+              VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+            }
+            waited_ns.fetch_add((uint64_t)waited.count());
+          }));
+          wait_s.push_back(waited_ns.load() * 1e-9);
+        } else {
+          clock_type::time_point start = clock_type::now();
+          std::vector<VkCommandBuffer> all;
+          for (thread_work &w : work)
+            all.insert(all.end(), w.buffers.begin(), w.buffers.end());
+          VK_CHECK(vkResetCommandPool(dev, merge_pool, 0));
+          VkCommandBufferBeginInfo begin_info{
+              VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+          begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+          vkBeginCommandBuffer(primary, &begin_info);
+          vkCmdExecuteCommands(primary, (uint32_t)all.size(), all.data());
+          vkEndCommandBuffer(primary);
+          VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+          submit_info.commandBufferCount = 1;
+          submit_info.pCommandBuffers = &primary;
+          VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+          submit_s.push_back(seconds_since(start));
+          wait_s.push_back(0.0);
+        }
+
+        // 5. Drain before the pools are reset; not part of any phase
+        VK_CHECK(vkQueueWaitIdle(queue));
+      }
+
+      recording_point point;
+      point.path = path;
+      point.threads = threads;
+      point.dispatches = (uint64_t)threads * opts.buffers_per_thread *
+                         opts.dispatches_per_buffer;
+      point.record_seconds = summarize(record_s).p50;
+      point.submit_seconds = summarize(submit_s).p50;
+      point.lock_wait_seconds = summarize(wait_s).p50;
+      points.push_back(point);
+
+      for (thread_work &w : work)
+        vkDestroyCommandPool(dev, w.pool, nullptr);
+    }
+  }
+
+  vkDestroyCommandPool(dev, merge_pool, nullptr);
+  noop.destroy(dev);
+  return points;
+}
+
+void print_recording_report(const std::vector<recording_point> &points,
+                            std::ostream &out) {
+  out << std::fixed << std::setprecision(0);
+  out << "Command recording and submission (dispatches/s)" << std::endl;
+  for (const recording_point &p : points) {
+    out << std::setw(9) << submit_path_name(p.path) << " | " << std::setw(3)
+        << p.threads << " threads | " << p.dispatches << " dispatches | "
+        << std::setw(11) << p.recorded_per_second() << " recorded/s | "
+        << std::setw(11) << p.submitted_per_second() << " submitted/s";
+    if (p.path == submit_path::shared_queue)
+      out << " | " << std::setprecision(3) << p.lock_wait_seconds * 1e3
+          << " ms waiting for the queue" << std::setprecision(0);
+    out << std::endl;
+  }
+  out << std::defaultfloat;
+}
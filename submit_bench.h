@@ -0,0 +1,64 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "gpu_system.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// How recorded work from many threads reaches the queue.
+enum class submit_path {
+  shared_queue,    // each thread submits its own primaries, one mutex
+                   // guarding the queue (Vulkan's external synchronization)
+  secondary_merge, // threads record secondaries, one thread executes them
+                   // all from a single primary and submits that
+};
+
+// "shared", "secondary"
+const char *submit_path_name(submit_path path);
+
+// One thread count over one path; times are medians over the repetitions.
+struct recording_point {
+  submit_path path = submit_path::shared_queue;
+  uint32_t threads = 0;
+  uint64_t dispatches = 0;       // over all threads
+  double record_seconds = 0.0;   // wall time, every thread recording at once
+  double submit_seconds = 0.0;   // wall time to get everything submitted
+  double lock_wait_seconds = 0.0; // summed over threads, shared_queue only
+
+  double recorded_per_second() const { return dispatches / record_seconds; }
+  double submitted_per_second() const { return dispatches / submit_seconds; }
+};
+
+struct recording_options {
+  std::vector<uint32_t> thread_counts = {1, 2, 4, 8};
+  uint32_t buffers_per_thread = 32;
+  uint32_t dispatches_per_buffer = 64; // each binds pipeline and set again
+  uint32_t repetitions = 5;
+};
+
+// For every thread count and both paths: N threads, each with its own
+// command pool, record buffers_per_thread command buffers of noop.spv
+// dispatches, all starting together; then the buffers are submitted as the
+// path says. Recording and submission are timed as separate phases and the
+// GPU is drained (untimed) between repetitions.
+std::vector<recording_point>
+run_recording_scaling(gpu_system &gpu, const recording_options &opts);
+
+void print_recording_report(const std::vector<recording_point> &points,
+                            std::ostream &out);
@@ -0,0 +1,313 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "sweep_cli.h"
+#include "cpu_latency.h"
+#include "gpu_chain.h"
+#include "gpu_system.h"
+#include "shader_pipeline.h"
+#include "sweep_driver.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+uint64_t parse_byte_size(const std::string &text) {
+  size_t used = 0;
+  double value = std::stod(text, &used);
+  std::string unit = text.substr(used);
+  double scale = 1.0;
+  if (unit == "K" || unit == "KB")
+    scale = 1024.0;
+  else if (unit == "M" || unit == "MB")
+    scale = 1024.0 * 1024.0;
+  else if (unit == "G" || unit == "GB")
+    scale = 1024.0 * 1024.0 * 1024.0;
+  else if (!unit.empty() && unit != "B")
+    throw std::invalid_argument("unknown size unit in " + text);
+  if (value <= 0.0)
+    throw std::invalid_argument("size must be positive: " + text);
+  return (uint64_t)(value * scale);
+}
+
+std::vector<uint64_t> parse_byte_sizes(const std::string &list) {
+  std::vector<uint64_t> sizes;
+  std::stringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ','))
+    sizes.push_back(parse_byte_size(item));
+  return sizes;
+}
+
+void parse_sweep_options(int argc, char **argv, int first,
+                         sweep_options &options) {
+  bool seed_given = false;
+  for (int i = first; i < argc; i++) {
+    std::string flag = argv[i];
+    // Flags without a value
+    if (flag == "--thp") {
+      options.backing = page_backing::transparent_huge;
+      continue;
+    }
+    if (flag == "--hugetlb") {
+      options.backing = page_backing::explicit_huge;
+      continue;
+    }
+    if (flag == "--counters") {
+      options.counters = true;
+      continue;
+    }
+    if (flag == "--overlap" || flag == "--no-overlap") {
+      options.overlap = flag == "--overlap"
+                            ? sweep_options::overlap_policy::always
+                            : sweep_options::overlap_policy::never;
+      continue;
+    }
+    if (flag == "--gpu-chains") {
+      options.gpu_chains = true;
+      continue;
+    }
+    if (flag.rfind("--numa=", 0) == 0) {
+      options.placement = numa_placement::parse(flag.substr(7));
+      continue;
+    }
+
+    if (i + 1 >= argc)
+      throw std::invalid_argument("missing value for " + flag);
+    std::string value = argv[++i];
+    if (flag == "--engine") {
+      if (value != "gpu" && value != "cpu")
+        throw std::invalid_argument("unknown engine: " + value);
+      options.engine = value;
+    } else if (flag == "--format") {
+      options.format = parse_output_format(value);
+    } else if (flag == "--sizes") {
+      options.sizes = parse_byte_sizes(value);
+    } else if (flag == "--min") {
+      options.min_bytes = parse_byte_size(value);
+    } else if (flag == "--max") {
+      options.max_bytes = parse_byte_size(value);
+    } else if (flag == "--scale") {
+      if (value != "log" && value != "linear")
+        throw std::invalid_argument("unknown scale: " + value);
+      options.log_scale = value == "log";
+    } else if (flag == "--per-octave") {
+      options.points_per_octave = (uint32_t)std::stoul(value);
+    } else if (flag == "--points") {
+      options.linear_points = (uint32_t)std::stoul(value);
+    } else if (flag == "--reps") {
+      options.repetitions = (uint32_t)std::stoul(value);
+    } else if (flag == "--hops") {
+      // The chase shaders take HOPS as a GLSL int
+      unsigned long hops = std::stoul(value);
+      if (hops == 0 || hops > (unsigned long)INT_MAX)
+        throw std::invalid_argument("--hops must be 1.." +
+                                    std::to_string(INT_MAX));
+      options.hops = (uint32_t)hops;
+    } else if (flag == "--seed") {
+      options.seed = std::stoull(value);
+      seed_given = true;
+    } else if (flag == "--chain-cache") {
+      options.chain_cache_dir = value;
+    } else if (flag == "--layout") {
+      options.layout = parse_chain_layout(value);
+    } else if (flag == "--device") {
+      options.device = gpu_system::find_device(value);
+    } else if (flag == "--memory-type") {
+      options.memory_type = std::stoi(value);
+    } else if (flag == "--cpu") {
+      options.cpu = std::stoi(value);
+    } else {
+      throw std::invalid_argument("unknown option: " + flag);
+    }
+  }
+
+  if (!options.chain_cache_dir.empty() && !seed_given)
+    options.seed = 0;
+
+  // A range replaces the default list, unless a list was given explicitly.
+  if ((options.min_bytes != 0) != (options.max_bytes != 0))
+    throw std::invalid_argument("--min and --max go together");
+  if (options.min_bytes > options.max_bytes)
+    throw std::invalid_argument("--min is larger than --max");
+  if (options.points_per_octave == 0 || options.linear_points == 0 ||
+      options.repetitions == 0 || options.hops == 0)
+    throw std::invalid_argument("counts must be at least 1");
+}
+
+std::vector<uint32_t> sweep_node_counts(const sweep_options &options) {
+  std::vector<uint64_t> sizes = options.sizes;
+  if (options.min_bytes != 0) {
+    sizes.clear();
+    double lo = (double)options.min_bytes, hi = (double)options.max_bytes;
+    if (options.log_scale) {
+      // min * 2^(k / points_per_octave) up to and including max
+      for (uint32_t k = 0;; k++) {
+        double s = lo * std::pow(2.0, (double)k / options.points_per_octave);
+        if (s > hi * (1.0 + 1e-9))
+          break;
+        sizes.push_back((uint64_t)s);
+      }
+    } else {
+      uint32_t n = options.linear_points;
+      for (uint32_t k = 0; k < n; k++)
+        sizes.push_back((uint64_t)(n == 1 ? lo : lo + (hi - lo) * k / (n - 1)));
+    }
+  }
+
+  // Whole 64-byte lines (so every layout has at least one full line), at
+  // most 2^32 - 1 nodes, no duplicates after rounding.
+  std::set<uint32_t> counts;
+  for (uint64_t bytes : sizes) {
+    uint64_t lines = std::max<uint64_t>(1, (bytes + 32) / 64);
+    counts.insert((uint32_t)std::min<uint64_t>(lines * 16, 0xFFFFFFF0u));
+  }
+  return std::vector<uint32_t>(counts.begin(), counts.end());
+}
+
+// "model name" from /proc/cpuinfo, or "host" where there is none.
+static std::string host_cpu_name() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) == 0) {
+      size_t colon = line.find(':');
+      if (colon != std::string::npos && colon + 2 <= line.size())
+        return line.substr(colon + 2);
+    }
+  }
+  return "host";
+}
+
+static int run_gpu_sweep(const sweep_options &options,
+                         const std::vector<uint32_t> &counts,
+                         result_writer &writer) {
+  gpu_system gpu;
+  gpu.initialize(options.device);
+
+  shader_pipeline pipeline;
+  pipeline.specialization_constants = {options.hops};
+  pipeline.prepare(gpu.logical_device_handle, "lat_comp.spv",
+                   gpu.push_descriptor_supported);
+
+  VkPhysicalDeviceMemoryProperties mem_properties;
+  vkGetPhysicalDeviceMemoryProperties(gpu.physical_device_handle,
+                                      &mem_properties);
+
+  sweep_driver sweep;
+  sweep.hops_per_dispatch = options.hops;
+  sweep.repetitions = options.repetitions;
+  sweep.layout = options.layout;
+  sweep.seed = options.seed;
+  sweep.collect_counters = options.counters;
+  sweep.placement = options.placement;
+  sweep.overlap = options.overlap;
+  chain_cache cache;
+  cache.directory = options.chain_cache_dir;
+  if (!cache.directory.empty())
+    sweep.cache = &cache;
+  gpu_chain_builder chain_builder;
+  if (options.gpu_chains) {
+    // Nothing is written from the host, so plain device-local memory will do
+    chain_builder.create(gpu);
+    sweep.chain_builder = &chain_builder;
+    sweep.memory_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  }
+  if (options.memory_type >= 0) {
+    // Any host-visible type will do once it is named explicitly (any type
+    // at all when the GPU builds the chains).
+    sweep.memory_flags =
+        options.gpu_chains ? 0 : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    sweep.memory_type_index = (uint32_t)options.memory_type;
+  }
+
+  const VkPhysicalDeviceProperties &props = gpu.device_properties;
+  run_metadata meta;
+  meta.engine = "gpu";
+  meta.device_name = props.deviceName;
+  meta.driver_version =
+      formatDriverVersion(props.vendorID, props.driverVersion);
+  meta.timestamp_period = props.limits.timestampPeriod;
+  meta.layout = chain_layout_name(options.layout);
+  meta.seed = options.seed;
+  meta.hops = options.hops;
+  writer.metadata = meta;
+
+  sweep.create(gpu, pipeline);
+  sweep.run(counts, [&](const sweep_point &point) {
+    writer.metadata.memory_type_index = (int)point.memory_type_index;
+    writer.metadata.memory_flags = formatMemoryFlags(
+        mem_properties.memoryTypes[point.memory_type_index].propertyFlags);
+    writer.write(point);
+  });
+  sweep.destroy();
+  chain_builder.destroy();
+
+  pipeline.destroy(gpu.logical_device_handle);
+  gpu.shutdown();
+  return 0;
+}
+
+static int run_cpu_sweep(const sweep_options &options,
+                         const std::vector<uint32_t> &counts,
+                         result_writer &writer) {
+  cpu_latency_engine engine;
+  engine.hops_per_measurement = options.hops;
+  engine.repetitions = options.repetitions;
+  engine.layout = options.layout;
+  engine.seed = options.seed;
+  chain_cache cache;
+  cache.directory = options.chain_cache_dir;
+  if (!cache.directory.empty())
+    engine.cache = &cache;
+  engine.cpu = options.cpu;
+  engine.backing = options.backing;
+  engine.placement = options.placement;
+  engine.create();
+
+  run_metadata meta;
+  meta.engine = "cpu";
+  meta.device_name = host_cpu_name();
+  meta.timestamp_period = engine.clock().ns_per_tick;
+  meta.layout = chain_layout_name(options.layout);
+  meta.seed = options.seed;
+  meta.hops = options.hops;
+  writer.metadata = meta;
+
+  engine.run(counts, [&](const sweep_point &point) {
+    writer.metadata.memory_flags = std::string(page_backing_name(
+                                       engine.backing_used)) +
+                                   " pages, " + engine.numa_used;
+    writer.write(point);
+  });
+  return 0;
+}
+
+int run_sweep(const sweep_options &options, std::ostream &out) {
+  std::vector<uint32_t> counts = sweep_node_counts(options);
+  if (counts.empty())
+    throw std::invalid_argument("no sizes to sweep");
+
+  result_writer writer;
+  writer.create(out, options.format, run_metadata());
+  return options.engine == "cpu" ? run_cpu_sweep(options, counts, writer)
+                                 : run_gpu_sweep(options, counts, writer);
+}
@@ -0,0 +1,94 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "host_buffer.h"
+#include "numa.h"
+#include "result_writer.h"
+#include "sweep_driver.h"
+#include "utils.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Everything a latency sweep can be told from the command line.
+struct sweep_options {
+  std::string engine = "gpu"; // "gpu" or "cpu"
+
+  // Working sets in bytes. An explicit --sizes list wins; otherwise
+  // --min/--max generate one, log-spaced (points per octave) or linear.
+  std::vector<uint64_t> sizes;
+  uint64_t min_bytes = 0, max_bytes = 0;
+  bool log_scale = true;
+  uint32_t points_per_octave = 1;
+  uint32_t linear_points = 8;
+
+  uint32_t repetitions = 1;
+  uint32_t hops = 1000000;
+  chain_layout layout = chain_layout::random;
+  uint64_t seed = random_seed();
+  // Directory of saved chains ("" = none). With one, the seed defaults to 0
+  // so that runs share their chains unless told otherwise.
+  std::string chain_cache_dir;
+
+  // GPU engine
+  uint32_t device = 0;
+  int memory_type = -1; // -1 = the first DEVICE_LOCAL|HOST_VISIBLE|COHERENT
+  // Build chains with chain_build.comp, in plain DEVICE_LOCAL memory unless
+  // a memory type is named; a seed then gives a different (but equally
+  // reproducible) chain than the host shuffle does.
+  bool gpu_chains = false;
+  // Pipeline-statistics and performance-query counters per point
+  bool counters = false;
+  // Shuffle the next size during a measurement (see sweep_driver::overlap)
+  using overlap_policy = sweep_driver::overlap_policy;
+  overlap_policy overlap = overlap_policy::automatic;
+
+  // CPU engine
+  int cpu = 0;
+  page_backing backing = page_backing::regular;
+  // Both engines: the CPU chain, or the GPU chains and their staging
+  numa_placement placement;
+
+  output_format format = output_format::text;
+};
+
+// Parses argv[first..argc) over `options` (which carries the defaults).
+// Flags:
+//   --engine gpu|cpu        --format text|ndjson|csv
+//   --sizes 64K,4M,1G       --min 64K --max 1G
+//   --scale log|linear      --per-octave N        --points N (linear)
+//   --reps N                --hops N              --seed N
+//   --layout random|line|sequential
+//   --device N|name         --memory-type N       --gpu-chains
+//   --chain-cache DIR       --counters            --overlap | --no-overlap
+//   --cpu N                 --thp | --hugetlb     --numa=<placement>
+// Throws std::invalid_argument on anything it does not understand.
+void parse_sweep_options(int argc, char **argv, int first,
+                         sweep_options &options);
+
+// "64K", "4M", "1G", "4096" -> bytes (binary multiples).
+uint64_t parse_byte_size(const std::string &text);
+// "64K,4M,1G" -> one parse_byte_size per comma-separated item.
+std::vector<uint64_t> parse_byte_sizes(const std::string &list);
+
+// Chain lengths in uint32_t nodes for the options' sizes, ascending.
+std::vector<uint32_t> sweep_node_counts(const sweep_options &options);
+
+// Runs the sweep and streams every point to `out`; returns the exit code.
+int run_sweep(const sweep_options &options, std::ostream &out);
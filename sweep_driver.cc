@@ -0,0 +1,261 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#include "sweep_driver.h"
+#include "utils.h"
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+
+void upload_shuffled_chain(memory_block &nodes, uint32_t count,
+                           std::vector<uint32_t> &scratch, chain_layout layout,
+                           uint64_t seed, const chain_cache *cache) {
+  if (!(nodes.memory_type_flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) &&
+      scratch.size() < count)
+    scratch.resize(count);
+  upload_shuffled_chain(nodes, count, scratch.data(), layout, seed, cache);
+}
+
+void upload_shuffled_chain(memory_block &nodes, uint32_t count,
+                           uint32_t *scratch, chain_layout layout,
+                           uint64_t seed, const chain_cache *cache) {
+  uint32_t *ptr = reinterpret_cast<uint32_t *>(nodes.map(VK_NULL_HANDLE));
+  if (cache && cache->load(ptr, count, layout, seed)) {
+    // Saved chain: one sequential copy out of the file, whatever the mapping.
+  } else if (nodes.memory_type_flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) {
+    // Cached mapping: shuffle in place, no extra host memory.
+    build_chain(ptr, count, layout, seed);
+    if (cache)
+      cache->save(ptr, count, layout, seed);
+  } else {
+    // Write-combined mapping: reads are very slow, so shuffle in host
+    // memory and stream the result across in one sequential copy.
+    build_chain(scratch, count, layout, seed);
+    std::memcpy(ptr, scratch, VkDeviceSize(count) * sizeof(uint32_t));
+    if (cache)
+      cache->save(scratch, count, layout, seed);
+  }
+  if (!(nodes.memory_type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    nodes.sync_to_gpu(VK_NULL_HANDLE);
+  nodes.unmap(VK_NULL_HANDLE);
+}
+
+void sweep_driver::create(gpu_system &gpu, shader_pipeline &pipeline,
+                          uint32_t queue_index) {
+  gpu_ = &gpu;
+  pipeline_ = &pipeline;
+  queue_ = gpu.compute_queues.at(queue_index);
+  VkDevice dev = gpu.logical_device_handle;
+  // The preparing worker is not pinned; fix local/remote here, once.
+  anchored_ = placement.anchored();
+  VkPhysicalDeviceType type = gpu.device_properties.deviceType;
+  overlap_ = overlap == overlap_policy::always ||
+             (overlap == overlap_policy::automatic &&
+              type != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU &&
+              type != VK_PHYSICAL_DEVICE_TYPE_CPU);
+
+  for (slot &s : slots_) {
+    // 1. A stopwatch per slot: two measurements can be in flight at once
+    s.stopwatch.create(dev, gpu.physical_device_handle);
+    if (collect_counters)
+      s.counters.create(gpu);
+
+    // 2. A long-lived pool per slot, reset before each recording
+    VkCommandPoolCreateInfo pool_info{
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.queueFamilyIndex = gpu.compute_queue_family_index;
+    VK_CHECK(vkCreateCommandPool(dev, &pool_info, nullptr, &s.command_pool));
+
+    VkCommandBufferAllocateInfo cb_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    cb_info.commandPool = s.command_pool;
+    cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cb_info.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(dev, &cb_info, &s.command_buffer));
+
+    // 3. The fence that says this slot's dispatch has finished
+    VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VK_CHECK(vkCreateFence(dev, &fence_info, nullptr, &s.fence));
+  }
+}
+
+void sweep_driver::prepare(slot &s, uint32_t count) {
+  VkDevice dev = gpu_->logical_device_handle;
+  VkDeviceSize size = VkDeviceSize(count) * sizeof(uint32_t);
+
+  // Whatever the slot held was measured two steps ago and is long done.
+  release(s);
+
+  scoped_numa_policy policy(anchored_);
+  s.nodes.create(dev, gpu_->physical_device_handle, size,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_flags,
+                 memory_type_index);
+  // The kernel only ever writes one uint to result.
+  s.result.create(dev, gpu_->physical_device_handle, sizeof(uint32_t),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_flags);
+
+  // A GPU-built chain has to wait for the queue, which belongs to the
+  // measuring thread; submit() builds it.
+  if (chain_builder) {
+    s.needs_gpu_chain = true;
+  } else {
+    // Write-combined mappings shuffle in scratch. It is placed like the
+    // chains and bound before first touch; a bigger size replaces it rather
+    // than growing it, so no page of it comes from anywhere else.
+    if (!(s.nodes.memory_type_flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) &&
+        scratch_.size < size) {
+      scratch_.destroy();
+      scratch_.create(size, page_backing::regular, anchored_);
+    }
+    upload_shuffled_chain(s.nodes, count, scratch_.as<uint32_t>(), layout,
+                          seed + count, cache);
+  }
+  s.count = count;
+}
+
+void sweep_driver::submit(slot &s) {
+  VkDevice dev = gpu_->logical_device_handle;
+
+  if (s.needs_gpu_chain) {
+    chain_builder->build(s.nodes, s.count, layout, seed + s.count);
+    if (chain_builder->verify(s.nodes, s.count, layout, seed + s.count) != 0)
+      throw std::runtime_error("GPU-built chain of " +
+                               std::to_string(s.count) +
+                               " nodes is not a single cycle");
+    s.needs_gpu_chain = false;
+  }
+
+  // bind_blocks hands out a cached set per slot; with two slots alive the
+  // set of the in-flight slot is never the one being rewritten.
+  pipeline_->bind_blocks(dev, {&s.nodes, &s.result});
+
+  VK_CHECK(vkResetCommandPool(dev, s.command_pool, 0));
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(s.command_buffer, &begin_info);
+  pipeline_->record(s.command_buffer, s.stopwatch,
+                    collect_counters ? &s.counters : nullptr);
+  vkEndCommandBuffer(s.command_buffer);
+
+  VK_CHECK(vkResetFences(dev, 1, &s.fence));
+  VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &s.command_buffer;
+  VK_CHECK(vkQueueSubmit(queue_, 1, &submit_info, s.fence));
+}
+
+sweep_point sweep_driver::collect(slot &s) {
+  VkDevice dev = gpu_->logical_device_handle;
+  VK_CHECK(vkWaitForFences(dev, 1, &s.fence, VK_TRUE, UINT64_MAX));
+
+  sweep_point point;
+  point.count = s.count;
+  point.bytes = VkDeviceSize(s.count) * sizeof(uint32_t);
+  point.ns_per_hop = s.stopwatch.get_nanoseconds(dev) / hops_per_dispatch;
+  point.memory_type_index = s.nodes.memory_type_index;
+  if (collect_counters)
+    point.counters = s.counters.results();
+  return point;
+}
+
+void sweep_driver::release(slot &s) {
+  s.nodes.destroy(VK_NULL_HANDLE);
+  s.result.destroy(VK_NULL_HANDLE);
+  s.count = 0;
+  s.needs_gpu_chain = false;
+}
+
+void sweep_driver::run(
+    const std::vector<uint32_t> &counts,
+    const std::function<void(const sweep_point &)> &on_point) {
+  if (counts.empty())
+    return;
+
+  auto bytes_of = [](uint32_t count) {
+    return VkDeviceSize(count) * sizeof(uint32_t);
+  };
+
+  // The first size has nothing to overlap with.
+  std::future<void> pending = std::async(
+      std::launch::deferred, [&] { prepare(slots_[0], counts[0]); });
+
+  for (size_t i = 0; i < counts.size(); i++) {
+    slot &current = slots_[i % 2];
+    pending.get(); // worker done (or run the deferred prepare right here)
+    submit(current);
+
+    // While size i is on the GPU, shuffle size i+1 into the other slot.
+    bool has_next = i + 1 < counts.size();
+    bool fits = host_budget_bytes == 0 ||
+                (has_next && bytes_of(counts[i]) + bytes_of(counts[i + 1]) <=
+                                 host_budget_bytes);
+    bool overlapped = has_next && overlap_ && fits;
+    if (overlapped) {
+      slot &next = slots_[(i + 1) % 2];
+      uint32_t next_count = counts[i + 1];
+      pending = std::async(std::launch::async,
+                           [this, &next, next_count] {
+                             prepare(next, next_count);
+                           });
+    }
+
+    on_point(collect(current));
+    for (uint32_t rep = 1; rep < repetitions; rep++) {
+      submit(current);
+      sweep_point point = collect(current);
+      point.repetition = rep;
+      on_point(point);
+    }
+
+    if (has_next && !overlapped) {
+      // Serial step: drop this chain before building the next one so at
+      // most one of them is resident.
+      release(current);
+      slot &next = slots_[(i + 1) % 2];
+      uint32_t next_count = counts[i + 1];
+      pending = std::async(std::launch::deferred,
+                           [this, &next, next_count] {
+                             prepare(next, next_count);
+                           });
+    }
+  }
+}
+
+void sweep_driver::destroy() {
+  if (gpu_ == nullptr)
+    return;
+  VkDevice dev = gpu_->logical_device_handle;
+
+  for (slot &s : slots_) {
+    release(s);
+    s.stopwatch.destroy(dev);
+    s.counters.destroy();
+    if (s.fence != VK_NULL_HANDLE)
+      vkDestroyFence(dev, s.fence, nullptr);
+    if (s.command_pool != VK_NULL_HANDLE)
+      vkDestroyCommandPool(dev, s.command_pool, nullptr);
+    s.fence = VK_NULL_HANDLE;
+    s.command_pool = VK_NULL_HANDLE;
+    s.command_buffer = VK_NULL_HANDLE;
+  }
+  scratch_.destroy();
+  gpu_ = nullptr;
+  pipeline_ = nullptr;
+  queue_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,162 @@
+/*
+ * ----------------------------------------------------------------------------
+ * PUBLIC DOMAIN AND DISCLAIMER NOTICE
+ * ----------------------------------------------------------------------------
+ * This software is released into the public domain using the Creative Commons
+ * Zero (CC0) designation. To the extent possible under law, the author(s)
+ * have waived all copyright and related or neighboring rights to this work.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ----------------------------------------------------------------------------
+ */
+#pragma once
+#include "chain_cache.h"
+#include "dispatch_counters.h"
+#include "gpu_chain.h"
+#include "gpu_system.h"
+#include "host_buffer.h"
+#include "memory_block.h"
+#include "numa.h"
+#include "shader_pipeline.h"
+#include "timer.h"
+#include "utils.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Fills `nodes` (host-visible, created for at least count uint32_t) with the
+// chain build_chain makes for (layout, seed). Cached mappings are built in
+// place; write-combined ones are built in `scratch` and copied across once.
+// With a cache, a saved chain is copied straight from its file instead, and
+// a freshly built one is saved for next time.
+void upload_shuffled_chain(memory_block &nodes, uint32_t count,
+                           std::vector<uint32_t> &scratch,
+                           chain_layout layout = chain_layout::random,
+                           uint64_t seed = random_seed(),
+                           const chain_cache *cache = nullptr);
+// The same with caller-owned scratch of at least `count` uint32_t (only
+// touched for write-combined mappings, so it may be null for cached ones).
+void upload_shuffled_chain(memory_block &nodes, uint32_t count,
+                           uint32_t *scratch, chain_layout layout,
+                           uint64_t seed, const chain_cache *cache = nullptr);
+
+// One measured point of a latency sweep.
+struct sweep_point {
+  uint32_t count = 0;     // chain length in uint32_t nodes
+  VkDeviceSize bytes = 0; // working set walked by the kernel
+  double ns_per_hop = 0.0;
+  uint32_t repetition = 0; // 0-based, over the same chain
+  uint32_t memory_type_index = 0; // where the GPU chain lived
+  // Hardware counters of the timed dispatch, when they were collected
+  std::vector<counter_value> counters;
+};
+
+// The "Assembly Line" for latency sweeps.
+// Two slots take turns: while the GPU chases the chain in one, a worker
+// thread allocates and shuffles the next size into the other, so neither the
+// host nor the GPU sits idle. Each slot has its own fence, command pool and
+// stopwatch, so nothing waits on the whole queue. The chain, the kernel and
+// the timestamps are those of a serial run, but the shuffle is not free: its
+// random writes (up to the size of the next chain) share DRAM and, on
+// unified-memory parts, the GPU's path to it with the chase being timed.
+// That is why `overlap` is off by default on integrated GPUs.
+class sweep_driver {
+public:
+  // Hops lat_comp.comp takes per dispatch; divides the measured time. Must
+  // match the HOPS specialization constant the pipeline was prepared with.
+  uint32_t hops_per_dispatch = 1000000;
+
+  // Timed dispatches per chain; each is reported as its own point.
+  uint32_t repetitions = 1;
+
+  // How chains are linked. Size `count` is built from seed + count, so a
+  // sweep is reproducible from its seed alone.
+  chain_layout layout = chain_layout::random;
+  uint64_t seed = random_seed();
+
+  // Memory the nodes buffer is allocated from.
+  VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  // Pins the nodes buffer to one memory type index (it must have
+  // memory_flags); any_memory_type takes the first match.
+  uint32_t memory_type_index = memory_block::any_memory_type;
+
+  // When set, chains are built (and checked) on the GPU right before their
+  // first measurement instead of shuffled on the host, so memory_flags need
+  // not include HOST_VISIBLE. The chains differ from host-built ones of the
+  // same seed, but are just as reproducible.
+  gpu_chain_builder *chain_builder = nullptr;
+
+  // When set (and chain_builder is not), host-built chains are loaded from
+  // and saved to this cache.
+  const chain_cache *cache = nullptr;
+
+  // Collects dispatch_counters around every timed dispatch into
+  // sweep_point::counters (whichever the device supports, possibly none).
+  bool collect_counters = false;
+
+  // Prepare the next size during a measurement only while both chains fit in
+  // this many bytes (0 = no limit); bigger pairs are done one at a time, with
+  // the finished slot released first.
+  VkDeviceSize host_budget_bytes = 0;
+
+  // Whether to prepare the next size during a measurement. automatic does
+  // on discrete GPUs only; integrated (unified-memory) ones, like the M4,
+  // prepare every size strictly before its measurement so that no host
+  // shuffle traffic runs beside the timed chase.
+  enum class overlap_policy { automatic, always, never };
+  overlap_policy overlap = overlap_policy::automatic;
+
+  // NUMA node the chains (and the shuffle scratch) are allocated on, applied
+  // to the preparing thread; local/remote are relative to the CPU create()
+  // is called on, since the worker that prepares may run anywhere. Only
+  // memory the driver backs with system pages is affected.
+  numa_placement placement;
+
+  // Sets up both slots for the given device and (prepared) pipeline;
+  // submissions go to gpu.compute_queues[queue_index].
+  void create(gpu_system &gpu, shader_pipeline &pipeline,
+              uint32_t queue_index = 0);
+
+  // Measures each chain length in `counts`, in order, calling on_point as
+  // each one completes.
+  void run(const std::vector<uint32_t> &counts,
+           const std::function<void(const sweep_point &)> &on_point);
+
+  // Frees the slots. Everything submitted has completed by the time run()
+  // returns, so this never waits.
+  void destroy();
+
+private:
+  struct slot {
+    memory_block nodes, result;
+    timer stopwatch;
+    dispatch_counters counters;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    uint32_t count = 0;
+    bool needs_gpu_chain = false; // allocated, chain_builder not run yet
+  };
+
+  void prepare(slot &s, uint32_t count); // runs on the worker thread
+  void submit(slot &s);
+  sweep_point collect(slot &s);
+  void release(slot &s);
+
+  gpu_system *gpu_ = nullptr;
+  shader_pipeline *pipeline_ = nullptr;
+  VkQueue queue_ = VK_NULL_HANDLE;
+  slot slots_[2];
+  numa_placement anchored_; // placement, local/remote fixed by create()
+  bool overlap_ = false;     // overlap, resolved for the device by create()
+  host_buffer scratch_;      // shuffle space for uncached mappings
+};
@@ -16,11 +16,13 @@
  * ----------------------------------------------------------------------------
  */
 #include "utils.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <stdexcept>
@@ -71,26 +73,123 @@ std::string formatBytes(uint64_t bytesize) {
   return ss.str();
 }
 
-/*
- * TODO:
- * For the 1GB test (256 million elements), std::vector<uint32_t> indices will
- allocate another 1GB of CPU memory. On a 36GB M4 Max, this is fine, but on an
- eventually push for a 16GB test, we might hit a memory wall.
+std::string formatMemoryFlags(VkMemoryPropertyFlags flags) {
+  const struct {
+    VkMemoryPropertyFlags bit;
+    const char *name;
+  } names[] = {
+      {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "DEVICE_LOCAL"},
+      {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "HOST_VISIBLE"},
+      {VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "HOST_COHERENT"},
+      {VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "HOST_CACHED"},
+      {VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, "LAZILY_ALLOCATED"},
+  };
 
-    Future Refinement: we could shuffle the dataPtr directly in-place using a
- Fisher-Yates algorithm to save that extra 1GB of CPU-side allocation.
- * */
+  std::string out;
+  for (const auto &n : names) {
+    if (flags & n.bit) {
+      if (!out.empty())
+        out += "|";
+      out += n.name;
+    }
+  }
+  return out.empty() ? "NONE" : out;
+}
 
-void initialize_and_shuffle_indices(uint32_t *dataPtr, uint32_t numElmts) {
+std::string formatDriverVersion(uint32_t vendorID, uint32_t driverVersion) {
+  std::stringstream ss;
+  if (vendorID == 0x10DE) { // NVIDIA: 10.8.8.6 bits
+    ss << (driverVersion >> 22) << "." << ((driverVersion >> 14) & 0xFF) << "."
+       << ((driverVersion >> 6) & 0xFF) << "." << (driverVersion & 0x3F);
+  } else if (vendorID == 0x8086) { // Intel on Windows: 18.14 bits
+    ss << (driverVersion >> 14) << "." << (driverVersion & 0x3FFF);
+  } else {
+    ss << VK_API_VERSION_MAJOR(driverVersion) << "."
+       << VK_API_VERSION_MINOR(driverVersion) << "."
+       << VK_API_VERSION_PATCH(driverVersion);
+  }
+  return ss.str();
+}
+
+const char *chain_layout_name(chain_layout layout) {
+  switch (layout) {
+  case chain_layout::line_random:
+    return "line";
+  case chain_layout::sequential:
+    return "sequential";
+  default:
+    return "random";
+  }
+}
+
+chain_layout parse_chain_layout(const std::string &name) {
+  for (chain_layout layout : {chain_layout::random, chain_layout::line_random,
+                              chain_layout::sequential})
+    if (name == chain_layout_name(layout))
+      return layout;
+  throw std::invalid_argument("unknown chain layout: " + name);
+}
+
+// Sattolo's variant of Fisher-Yates: swapping only with strictly earlier
+// slots turns the identity into a single cycle through all numElmts nodes,
+// uniformly chosen among all such cycles (the same distribution as shuffling
+// an index list and linking it up). Working in place means the 1GB test no
+// longer needs a second 1GB index vector on the host.
+// Here it runs over the nodes k * stride only, so each of them ends up
+// pointing at the next of a single cycle through all of them.
+//
+// The slot is drawn with Lemire's multiply-shift and rejection straight from
+// the engine's output rather than with std::uniform_int_distribution, whose
+// algorithm each C++ library picks for itself: mt19937_64 is fully specified,
+// so a seed gives the same chain with libc++ and libstdc++ alike.
+static uint32_t below(uint32_t bound, std::mt19937_64 &g) {
+  uint64_t m = (g() >> 32) * bound;
+  if ((uint32_t)m < bound) {
+    uint32_t threshold = (0u - bound) % bound;
+    while ((uint32_t)m < threshold)
+      m = (g() >> 32) * bound;
+  }
+  return (uint32_t)(m >> 32);
+}
+
+static void sattolo_strided(uint32_t *dataPtr, uint32_t nodes, uint32_t stride,
+                            std::mt19937_64 &g) {
+  for (uint32_t k = 0; k < nodes; k++)
+    dataPtr[(size_t)k * stride] = k * stride;
+  for (uint32_t i = nodes - 1; i > 0; --i) {
+    std::swap(dataPtr[(size_t)i * stride],
+              dataPtr[(size_t)below(i, g) * stride]);
+  }
+}
+
+void build_chain(uint32_t *dataPtr, uint32_t numElmts, chain_layout layout,
+                 uint64_t seed) {
   assert(numElmts > 0 && "num elements must be non-zero");
-  std::vector<uint32_t> indices(numElmts);
-  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937_64 g(seed);
+  switch (layout) {
+  case chain_layout::sequential:
+    for (uint32_t i = 0; i < numElmts; i++)
+      dataPtr[i] = i + 1 == numElmts ? 0 : i + 1;
+    break;
+  case chain_layout::line_random: {
+    // 16 uint32 nodes per line; the words a hop never lands on stay 0.
+    const uint32_t stride = 16;
+    std::fill(dataPtr, dataPtr + numElmts, 0u);
+    sattolo_strided(dataPtr, (numElmts + stride - 1) / stride, stride, g);
+    break;
+  }
+  default:
+    sattolo_strided(dataPtr, numElmts, 1, g);
+    break;
+  }
+}
+
+uint64_t random_seed() {
   std::random_device rd;
-  std::mt19937 g(rd());
-  std::shuffle(indices.begin(), indices.end(), g);
+  return ((uint64_t)rd() << 32) | rd();
+}
 
-  for (uint32_t i = 0; i < numElmts - 1; ++i) {
-    dataPtr[indices[i]] = indices[i + 1];
-  }
-  dataPtr[indices[numElmts - 1]] = indices[0];
+// A random cycle from a fresh seed.
+void initialize_and_shuffle_indices(uint32_t *dataPtr, uint32_t numElmts) {
+  build_chain(dataPtr, numElmts, chain_layout::random, random_seed());
 }
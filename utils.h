@@ -32,7 +32,38 @@ std::vector<uint8_t> readBinaryFile(const std::string &filePath);
 // a simple formatter than returns number of Bytes, KB, MB etc. to TB for a
 // given bytesize
 std::string formatBytes(uint64_t bytesize);
+// Spells out memory property flags, e.g. "DEVICE_LOCAL|HOST_VISIBLE"
+std::string formatMemoryFlags(VkMemoryPropertyFlags flags);
+// Vendor-specific driverVersion packing spelled out, e.g. "550.54.14" for
+// NVIDIA, "1.0.0" for the standard VK_MAKE_VERSION layout.
+std::string formatDriverVersion(uint32_t vendorID, uint32_t driverVersion);
+
+// How build_chain links the nodes of a chain.
+enum class chain_layout {
+  random,      // one random cycle through every node
+  line_random, // one random cycle through the first node of every 64-byte
+               // line, so every hop lands on a new line
+  sequential,  // i -> i + 1, wrapping: what prefetchers like best
+};
+
+// "random", "line", "sequential"
+const char *chain_layout_name(chain_layout layout);
+// Inverse of chain_layout_name; throws std::invalid_argument.
+chain_layout parse_chain_layout(const std::string &name);
+
+// Writes a chain over numElmts nodes starting (and ending) at node 0, the
+// node every kernel starts from. The same (layout, seed) always gives the
+// same chain, with any C++ library, so runs can be reproduced. Like the
+// shuffle below, it reads dataPtr back: build into host memory when the
+// target is uncached.
+void build_chain(uint32_t *dataPtr, uint32_t numElmts, chain_layout layout,
+                 uint64_t seed);
+
+// A fresh 64-bit seed from std::random_device, for runs not given one.
+uint64_t random_seed();
+
 // Set up numElmts shuffled data but make sure to call vkMapMemory to initialize
 // input array, dataPtr, first. 0..numElmts-1 will have been shuffled in the
-// array.
+// array. The shuffle runs in place and reads dataPtr back, so on uncached
+// (write-combined) mappings shuffle into host memory and copy instead.
 void initialize_and_shuffle_indices(uint32_t *dataPtr, uint32_t numElmts);